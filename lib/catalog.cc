@@ -0,0 +1,1000 @@
+#include <catalog.h>
+
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <type_traits>
+
+namespace iris {
+namespace data {
+
+static std::string strip_ext(const std::string &name) {
+    size_t pos = name.rfind('.');
+    return pos == std::string::npos ? name : name.substr(0, pos);
+}
+
+// newest first, i.e. by name descending (names start with the timestamp)
+static bool by_name_desc(const fs::file &a, const fs::file &b) {
+    return a.name() > b.name();
+}
+
+// binary (de)serialization for the on-disk index, native byte order
+namespace {
+
+struct index_writer {
+    std::string buf;
+
+    template<typename T>
+    void pod(const T &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "index: need plain data");
+        buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+    }
+
+    void str(const std::string &s) {
+        pod(static_cast<uint32_t>(s.size()));
+        buf.append(s);
+    }
+
+    void display(const data::display &d) {
+        str(d.monitor_id);
+        str(d.settings_id);
+        str(d.link_id);
+        str(d.gfx);
+        pod(d.mode);
+    }
+};
+
+struct index_reader {
+    index_reader(const std::string &data) : pos(data.data()), end(data.data() + data.size()) { }
+
+    const char *take(size_t n) {
+        if (static_cast<size_t>(end - pos) < n) {
+            throw std::runtime_error("store index: truncated");
+        }
+        const char *p = pos;
+        pos += n;
+        return p;
+    }
+
+    template<typename T>
+    T pod() {
+        T v;
+        std::memcpy(&v, take(sizeof(T)), sizeof(T));
+        return v;
+    }
+
+    std::string str() {
+        uint32_t n = pod<uint32_t>();
+        return std::string(take(n), n);
+    }
+
+    data::display display() {
+        data::display d;
+        d.monitor_id = str();
+        d.settings_id = str();
+        d.link_id = str();
+        d.gfx = str();
+        d.mode = pod<monitor::mode>();
+        return d;
+    }
+
+    const char *pos;
+    const char *end;
+};
+
+const char     index_magic[8] = {'I', 'R', 'I', 'S', 'I', 'D', 'X', '\0'};
+const uint32_t index_version = 1;
+const uint32_t index_byteorder = 0x01020304;
+
+}
+
+static void load_links(const fs::file &linkfile,
+                       std::map<std::pair<std::string, std::string>, std::string> &links) {
+    links.clear();
+
+    if (!linkfile.exists()) {
+        return;
+    }
+
+    fs::mapped_file view = linkfile.map();
+    fs::mapped_istream in(view);
+    YAML::Node root = YAML::Load(in);
+    for (const auto &gfx : root) {
+        if (!gfx.second.IsMap()) {
+            continue;
+        }
+
+        for (const auto &link : gfx.second) {
+            links[std::make_pair(gfx.first.as<std::string>(), link.first.as<std::string>())] =
+                    link.second.as<std::string>();
+        }
+    }
+}
+
+// the *.isoslant (newest first) and *.isodata (by name) files of a subject
+static void list_subject_files(const fs::file &dir, store::catalog::subject_entry &entry) {
+    entry.isoslants.clear();
+    entry.isodata.clear();
+
+    for (const fs::file &f : dir.children("*.isoslant", fs::file_type::regular)) {
+        entry.isoslants.push_back(f);
+    }
+
+    for (const fs::file &f : dir.children("*.isodata", fs::file_type::regular)) {
+        entry.isodata.push_back(f);
+    }
+
+    std::sort(entry.isoslants.begin(), entry.isoslants.end(), by_name_desc);
+    std::sort(entry.isodata.begin(), entry.isodata.end(), [](const fs::file &a, const fs::file &b) {
+        return a.name() < b.name();
+    });
+}
+
+// the ids of the *.settings files of a monitor, newest first
+static std::vector<std::string> settings_ids(const fs::file &dir) {
+    fs::file::dir_enum files = dir.children("*.settings", fs::file_type::regular);
+    std::vector<fs::file> res(files.begin(), files.end());
+
+    std::sort(res.begin(), res.end(), by_name_desc);
+
+    std::vector<std::string> ids;
+    std::transform(res.begin(), res.end(), std::back_inserter(ids), [](const fs::file &f) {
+        return strip_ext(f.name());
+    });
+
+    return ids;
+}
+
+store::catalog::catalog(const fs::file &base) : base(base) {
+
+}
+
+std::shared_ptr<store::catalog> store::catalog::shared(const fs::file &base) {
+    static std::mutex registry_lock;
+    static std::map<std::string, std::shared_ptr<catalog>> registry;
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+    std::shared_ptr<catalog> &cat = registry[base.path()];
+
+    if (!cat) {
+        cat = std::make_shared<catalog>(base);
+    }
+
+    return cat;
+}
+
+store::catalog::display_key store::catalog::key_of(const display &d) {
+    return std::make_tuple(d.monitor_id, d.settings_id, d.link_id, d.gfx);
+}
+
+// monitors
+
+void store::catalog::need_monitors() const {
+    if (have_monitors) {
+        return;
+    }
+
+    read_index();
+    bool restored = restore_monitors(blobs[MONITORS]);
+
+    if (!restored) {
+        scan_monitors();
+    }
+
+    have_monitors = true;
+
+    if (!restored) {
+        save_index();
+    }
+}
+
+void store::catalog::scan_monitors() const {
+    mons.clear();
+    cals.clear();
+    links.clear();
+
+    // stamped before reading, so that changes while we
+    // scan invalidate the index on the next start
+    stamps[MONITORS].clear();
+    stamp(MONITORS, "monitors");
+    stamp(MONITORS, "links.cfg");
+
+    fs::file mdir = base.child("monitors");
+    if (mdir.is_directory()) {
+        for (const fs::file &dir : mdir.children("", fs::file_type::directory)) {
+            const std::string uid = dir.name();
+            stamp(MONITORS, "monitors/" + uid);
+
+            bool have_info = false;
+            monitor_entry entry;
+
+            for (const fs::file &f : dir.children("", fs::file_type::regular)) {
+                const std::string &n = f.name();
+
+                try {
+                    if (n == uid + ".monitor") {
+                        entry.info = yaml2monitor(f.read_all());
+                        have_info = true;
+                    } else if (fs::fn_matcher("*.rgb2lms")(n)) {
+                        rgb2lms cal = yaml2rgb2lms(f.read_all());
+                        cals[key_of(cal.dsy)].emplace_back(n, cal);
+                    }
+                } catch (const std::exception &e) {
+                    std::cerr << "[W] store: skipping " << f.path() << ": " << e.what() << std::endl;
+                }
+            }
+
+            if (!have_info) {
+                continue;
+            }
+
+            entry.settings = settings_ids(dir);
+            mons[uid] = entry;
+        }
+    }
+
+    for (auto &kv : cals) {
+        std::sort(kv.second.begin(), kv.second.end(),
+                  [](const std::pair<std::string, rgb2lms> &a, const std::pair<std::string, rgb2lms> &b) {
+                      return a.first > b.first;
+                  });
+    }
+
+    load_links(base.child("links.cfg"), links);
+}
+
+std::vector<std::string> store::catalog::monitor_ids() const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_monitors();
+
+    std::vector<std::string> ids;
+    for (const auto &kv : mons) {
+        ids.push_back(kv.first);
+    }
+
+    return ids;
+}
+
+bool store::catalog::find_monitor(const std::string &uid, monitor_entry &entry) const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_monitors();
+
+    auto iter = mons.find(uid);
+    if (iter == mons.end()) {
+        return false;
+    }
+
+    entry = iter->second;
+    return true;
+}
+
+bool store::catalog::latest_rgb2lms(const display &d, rgb2lms &cal) const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_monitors();
+
+    auto iter = cals.find(key_of(d));
+    if (iter == cals.end() || iter->second.empty()) {
+        return false;
+    }
+
+    //FIXME:: check mode too
+    cal = iter->second.front().second;
+    return true;
+}
+
+bool store::catalog::find_link(const std::string &gfx, const std::string &monitor_id, std::string &link) const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_monitors();
+
+    auto iter = links.find(std::make_pair(gfx, monitor_id));
+    if (iter == links.end()) {
+        return false;
+    }
+
+    link = iter->second;
+    return true;
+}
+
+void store::catalog::add_rgb2lms(const fs::file &f, const rgb2lms &cal) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!have_monitors) {
+        return; // picked up by the scan
+    }
+
+    auto &list = cals[key_of(cal.dsy)];
+    auto pos = std::find_if(list.begin(), list.end(), [&f](const std::pair<std::string, rgb2lms> &e) {
+        return e.first <= f.name();
+    });
+
+    if (pos != list.end() && pos->first == f.name()) {
+        pos->second = cal;
+    } else {
+        list.insert(pos, std::make_pair(f.name(), cal));
+    }
+
+    stamp(MONITORS, "monitors/" + f.parent().name());
+    save_index();
+}
+
+// subjects
+
+void store::catalog::need_subjects() const {
+    if (have_subjects) {
+        return;
+    }
+
+    search.clear();
+    have_search = false;
+
+    read_index();
+    bool restored = restore_subjects(blobs[SUBJECTS]);
+
+    if (!restored) {
+        scan_subjects();
+    }
+
+    have_subjects = true;
+
+    if (!restored) {
+        save_index();
+    }
+}
+
+void store::catalog::scan_subjects() const {
+    subs.clear();
+
+    stamps[SUBJECTS].clear();
+    stamp(SUBJECTS, "subjects");
+
+    fs::file sdir = base.child("subjects");
+    if (!sdir.is_directory()) {
+        return;
+    }
+
+    for (const fs::file &dir : sdir.children("", fs::file_type::directory)) {
+        const std::string uid = dir.name();
+        stamp(SUBJECTS, "subjects/" + uid);
+
+        fs::file sf = dir.child(uid + ".subject");
+        if (!sf.exists()) {
+            continue;
+        }
+
+        subject_entry entry;
+        try {
+            entry.info = yaml2subject(sf.read_all());
+        } catch (const std::exception &e) {
+            std::cerr << "[W] store: skipping " << sf.path() << ": " << e.what() << std::endl;
+            continue;
+        }
+
+        list_subject_files(dir, entry);
+        subs[uid] = entry;
+    }
+}
+
+static std::vector<std::string> search_keys(const subject &s) {
+    std::vector<std::string> keys = {s.identifier(), s.qualified_id(), s.initials, s.name};
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+void store::catalog::need_search() const {
+    need_subjects();
+
+    if (have_search) {
+        return;
+    }
+
+    for (const auto &kv : subs) {
+        for (const std::string &key : search_keys(kv.second.info)) {
+            search.emplace(key, kv.first);
+        }
+    }
+
+    have_search = true;
+}
+
+std::vector<subject> store::catalog::search_subjects(const std::string &phrase, bool prefix) const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_search();
+
+    std::set<std::string> uids;
+    if (prefix) {
+        for (auto iter = search.lower_bound(phrase);
+             iter != search.end() && iter->first.compare(0, phrase.size(), phrase) == 0;
+             ++iter) {
+            uids.insert(iter->second);
+        }
+    } else {
+        auto range = search.equal_range(phrase);
+        for (auto iter = range.first; iter != range.second; ++iter) {
+            uids.insert(iter->second);
+        }
+    }
+
+    std::vector<subject> res;
+    for (const std::string &uid : uids) {
+        res.push_back(subs.at(uid).info);
+    }
+
+    return res;
+}
+
+void store::catalog::add_subject(const std::string &uid, const subject &s) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!have_subjects) {
+        return; // picked up by the scan
+    }
+
+    if (have_search) {
+        for (auto iter = search.begin(); iter != search.end();) {
+            iter = iter->second == uid ? search.erase(iter) : std::next(iter);
+        }
+
+        for (const std::string &key : search_keys(s)) {
+            search.emplace(key, uid);
+        }
+    }
+
+    subs[uid].info = s;
+
+    stamp(SUBJECTS, "subjects");
+    stamp(SUBJECTS, "subjects/" + uid);
+    save_index();
+}
+
+std::vector<subject> store::catalog::subjects() const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_subjects();
+
+    std::vector<subject> res;
+    for (const auto &kv : subs) {
+        res.push_back(kv.second.info);
+    }
+
+    return res;
+}
+
+bool store::catalog::find_subject(const std::string &uid, subject_entry &entry) const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_subjects();
+
+    auto iter = subs.find(uid);
+    if (iter == subs.end()) {
+        return false;
+    }
+
+    entry = iter->second;
+    return true;
+}
+
+std::vector<fs::file> store::catalog::isodata() const {
+    std::lock_guard<std::mutex> guard(lock);
+    need_subjects();
+
+    std::vector<fs::file> res;
+    for (const auto &kv : subs) {
+        res.insert(res.end(), kv.second.isodata.begin(), kv.second.isodata.end());
+    }
+
+    std::sort(res.begin(), res.end(), [](const fs::file &a, const fs::file &b) {
+        return a.path() < b.path();
+    });
+
+    return res;
+}
+
+bool store::catalog::insert_isoslant(const std::string &subject_id, const fs::file &f) {
+    auto iter = subs.find(subject_id);
+    if (!have_subjects || iter == subs.end()) {
+        return false;
+    }
+
+    std::vector<fs::file> &list = iter->second.isoslants;
+    auto pos = std::find_if(list.begin(), list.end(), [&f](const fs::file &e) {
+        return e.name() <= f.name();
+    });
+
+    if (pos == list.end() || pos->name() != f.name()) {
+        list.insert(pos, f);
+    }
+
+    stamp(SUBJECTS, "subjects/" + subject_id);
+    return true;
+}
+
+void store::catalog::add_isoslant(const std::string &subject_id, const fs::file &f) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (insert_isoslant(subject_id, f)) {
+        save_index();
+    }
+}
+
+void store::catalog::add_isoslants(const std::vector<std::pair<std::string, fs::file>> &entries) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    bool changed = false;
+    for (const auto &e : entries) {
+        changed = insert_isoslant(e.first, e.second) || changed;
+    }
+
+    if (changed) {
+        save_index();
+    }
+}
+
+void store::catalog::add_isodata(const std::string &subject_id, const fs::file &f) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    auto iter = subs.find(subject_id);
+    if (!have_subjects || iter == subs.end()) {
+        return;
+    }
+
+    std::vector<fs::file> &list = iter->second.isodata;
+    auto pos = std::find_if(list.begin(), list.end(), [&f](const fs::file &e) {
+        return e.name() >= f.name();
+    });
+
+    if (pos == list.end() || pos->name() != f.name()) {
+        list.insert(pos, f);
+    }
+
+    stamp(SUBJECTS, "subjects/" + subject_id);
+    save_index();
+}
+
+template<typename Less>
+static void insert_file(std::vector<fs::file> &list, const fs::file &f, Less less) {
+    auto pos = std::find_if(list.begin(), list.end(), [&](const fs::file &e) {
+        return !less(e, f);
+    });
+
+    if (pos == list.end() || pos->name() != f.name()) {
+        list.insert(pos, f);
+    }
+}
+
+static void remove_file(std::vector<fs::file> &list, const std::string &name) {
+    list.erase(std::remove_if(list.begin(), list.end(), [&name](const fs::file &e) {
+        return e.name() == name;
+    }), list.end());
+}
+
+void store::catalog::update(const std::string &rel, bool removed) {
+    std::lock_guard<std::mutex> guard(lock);
+
+    size_t sep = rel.find('/');
+    size_t last = rel.rfind('/');
+    const std::string top = rel.substr(0, sep);
+    const std::string dir = sep == last ? "" : rel.substr(sep + 1, last - sep - 1);
+    const std::string name = rel.substr(last + 1);
+    const fs::file f = base.child(rel);
+
+    try {
+        if (removed && sep != std::string::npos && sep == last) {
+            // a whole monitor or subject directory went away
+            if (top == "monitors" && have_monitors) {
+                mons.erase(name);
+                for (auto iter = cals.begin(); iter != cals.end();) {
+                    iter = std::get<0>(iter->first) == name ? cals.erase(iter) : std::next(iter);
+                }
+
+                stamps[MONITORS].erase(rel);
+                stamp(MONITORS, "monitors");
+
+            } else if (top == "subjects" && have_subjects) {
+                subs.erase(name);
+                search.clear();
+                have_search = false;
+
+                stamps[SUBJECTS].erase(rel);
+                stamp(SUBJECTS, "subjects");
+
+            } else {
+                return;
+            }
+
+        } else if (rel == "links.cfg" && have_monitors) {
+            load_links(f, links);
+            stamp(MONITORS, "links.cfg");
+
+        } else if (top == "monitors" && !dir.empty() && have_monitors) {
+            stamp(MONITORS, "monitors/" + dir);
+
+            if (name == dir + ".monitor") {
+                if (removed) {
+                    mons.erase(dir);
+                } else {
+                    monitor_entry &entry = mons[dir];
+                    entry.info = yaml2monitor(f.read_all());
+                    entry.settings = settings_ids(f.parent());
+                }
+
+            } else if (fs::fn_matcher("*.settings")(name)) {
+                auto iter = mons.find(dir);
+                if (iter != mons.end()) {
+                    iter->second.settings = settings_ids(f.parent());
+                }
+
+            } else if (fs::fn_matcher("*.rgb2lms")(name)) {
+                // the display may have changed, drop the old entry wherever it is
+                for (auto &kv : cals) {
+                    auto &list = kv.second;
+                    list.erase(std::remove_if(list.begin(), list.end(),
+                                              [&name](const std::pair<std::string, rgb2lms> &e) {
+                                                  return e.first == name;
+                                              }), list.end());
+                }
+
+                if (!removed) {
+                    rgb2lms cal = yaml2rgb2lms(f.read_all());
+                    auto &list = cals[key_of(cal.dsy)];
+                    auto pos = std::find_if(list.begin(), list.end(), [&name](const std::pair<std::string, rgb2lms> &e) {
+                        return e.first <= name;
+                    });
+                    list.insert(pos, std::make_pair(name, cal));
+                }
+            } else {
+                return;
+            }
+
+        } else if (top == "subjects" && !dir.empty() && have_subjects) {
+            stamp(SUBJECTS, "subjects/" + dir);
+
+            if (name == dir + ".subject") {
+                if (removed) {
+                    subs.erase(dir);
+                } else {
+                    bool is_new = subs.find(dir) == subs.end();
+                    subject_entry &entry = subs[dir];
+                    entry.info = yaml2subject(f.read_all());
+                    if (is_new) {
+                        list_subject_files(f.parent(), entry);
+                    }
+                }
+
+                search.clear();
+                have_search = false;
+
+            } else if (fs::fn_matcher("*.isoslant")(name) || fs::fn_matcher("*.isodata")(name)) {
+                auto iter = subs.find(dir);
+                if (iter == subs.end()) {
+                    return;
+                }
+
+                const bool is_isoslant = fs::fn_matcher("*.isoslant")(name);
+                std::vector<fs::file> &list = is_isoslant ? iter->second.isoslants : iter->second.isodata;
+
+                if (removed) {
+                    remove_file(list, name);
+                } else if (is_isoslant) {
+                    insert_file(list, f, by_name_desc);
+                } else {
+                    insert_file(list, f, [](const fs::file &a, const fs::file &b) {
+                        return a.name() < b.name();
+                    });
+                }
+            } else {
+                return;
+            }
+
+        } else {
+            return;
+        }
+
+    } catch (const std::exception &e) {
+        std::cerr << "[W] store: could not update from " << f.path() << ": " << e.what() << std::endl;
+        return;
+    }
+
+    save_index();
+}
+
+void store::catalog::invalidate() {
+    std::lock_guard<std::mutex> guard(lock);
+
+    have_monitors = false;
+    have_subjects = false;
+
+    mons.clear();
+    cals.clear();
+    links.clear();
+    subs.clear();
+    search.clear();
+    have_search = false;
+
+    // do not trust the index either, it is rewritten on the next scan
+    index_read = true;
+    for (int s = MONITORS; s <= SUBJECTS; s++) {
+        blobs[s].clear();
+        stamps[s].clear();
+    }
+}
+
+// on-disk index
+
+void store::catalog::stamp(section s, const std::string &rel) const {
+    stamps[s][rel] = base.child(rel).mtime();
+}
+
+bool store::catalog::stamps_valid(section s) const {
+    for (const auto &kv : stamps[s]) {
+        if (base.child(kv.first).mtime() != kv.second) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void store::catalog::read_index() const {
+    if (index_read) {
+        return;
+    }
+
+    index_read = true;
+
+    fs::file f = base.child("catalog.idx");
+    if (!f.exists()) {
+        return;
+    }
+
+    try {
+        std::string data = f.read_all();
+        index_reader in(data);
+
+        if (std::memcmp(in.take(sizeof(index_magic)), index_magic, sizeof(index_magic)) != 0 ||
+            in.pod<uint32_t>() != index_version ||
+            in.pod<uint32_t>() != index_byteorder) {
+            return; // foreign or outdated, rebuilt on the next scan
+        }
+
+        for (int s = MONITORS; s <= SUBJECTS; s++) {
+            uint64_t len = in.pod<uint64_t>();
+            blobs[s] = std::string(in.take(len), len);
+        }
+
+    } catch (const std::exception &e) {
+        blobs[MONITORS].clear();
+        blobs[SUBJECTS].clear();
+    }
+}
+
+void store::catalog::save_index() const {
+    if (have_monitors) {
+        blobs[MONITORS] = dump_monitors();
+    }
+
+    if (have_subjects) {
+        blobs[SUBJECTS] = dump_subjects();
+    }
+
+    index_writer out;
+    out.buf.append(index_magic, sizeof(index_magic));
+    out.pod(index_version);
+    out.pod(index_byteorder);
+
+    for (int s = MONITORS; s <= SUBJECTS; s++) {
+        out.pod(static_cast<uint64_t>(blobs[s].size()));
+        out.buf.append(blobs[s]);
+    }
+
+    try {
+        base.child("catalog.idx").write_all(out.buf);
+    } catch (const std::exception &e) {
+        // read-only store, we just scan every time
+    }
+}
+
+static void dump_stamps(index_writer &out, const std::map<std::string, int64_t> &stamps) {
+    out.pod(static_cast<uint32_t>(stamps.size()));
+    for (const auto &kv : stamps) {
+        out.str(kv.first);
+        out.pod(kv.second);
+    }
+}
+
+static std::map<std::string, int64_t> restore_stamps(index_reader &in) {
+    std::map<std::string, int64_t> stamps;
+    uint32_t n = in.pod<uint32_t>();
+    for (uint32_t i = 0; i < n; i++) {
+        std::string rel = in.str();
+        stamps[rel] = in.pod<int64_t>();
+    }
+    return stamps;
+}
+
+std::string store::catalog::dump_monitors() const {
+    index_writer out;
+    dump_stamps(out, stamps[MONITORS]);
+
+    out.pod(static_cast<uint32_t>(mons.size()));
+    for (const auto &kv : mons) {
+        const monitor &m = kv.second.info;
+        out.str(kv.first);
+        out.str(m.identifier());
+        out.str(m.vendor);
+        out.str(m.name);
+        out.str(m.year);
+        out.str(m.notes);
+        out.str(m.serial);
+        out.pod(m.default_mode);
+
+        out.pod(static_cast<uint32_t>(kv.second.settings.size()));
+        for (const std::string &sid : kv.second.settings) {
+            out.str(sid);
+        }
+    }
+
+    uint32_t ncals = 0;
+    for (const auto &kv : cals) {
+        ncals += static_cast<uint32_t>(kv.second.size());
+    }
+
+    out.pod(ncals);
+    for (const auto &kv : cals) {
+        for (const auto &entry : kv.second) {
+            const rgb2lms &cal = entry.second;
+            out.str(entry.first);
+            out.str(cal.identifier());
+            out.pod(cal.width);
+            out.pod(cal.height);
+            out.pod(cal.gray_level);
+            out.display(cal.dsy);
+            out.pod(cal.dkl_params);
+            out.str(cal.dataset);
+        }
+    }
+
+    out.pod(static_cast<uint32_t>(links.size()));
+    for (const auto &kv : links) {
+        out.str(kv.first.first);
+        out.str(kv.first.second);
+        out.str(kv.second);
+    }
+
+    return out.buf;
+}
+
+bool store::catalog::restore_monitors(const std::string &blob) const {
+    if (blob.empty()) {
+        return false;
+    }
+
+    try {
+        index_reader in(blob);
+        stamps[MONITORS] = restore_stamps(in);
+
+        if (!stamps_valid(MONITORS)) {
+            stamps[MONITORS].clear();
+            return false;
+        }
+
+        uint32_t nmons = in.pod<uint32_t>();
+        for (uint32_t i = 0; i < nmons; i++) {
+            std::string uid = in.str();
+            monitor_entry &entry = mons[uid];
+
+            monitor &m = entry.info;
+            m = monitor(in.str());
+            m.vendor = in.str();
+            m.name = in.str();
+            m.year = in.str();
+            m.notes = in.str();
+            m.serial = in.str();
+            m.default_mode = in.pod<monitor::mode>();
+
+            uint32_t nsettings = in.pod<uint32_t>();
+            for (uint32_t k = 0; k < nsettings; k++) {
+                entry.settings.push_back(in.str());
+            }
+        }
+
+        uint32_t ncals = in.pod<uint32_t>();
+        for (uint32_t i = 0; i < ncals; i++) {
+            std::string name = in.str();
+            rgb2lms cal(in.str());
+            cal.width = in.pod<float>();
+            cal.height = in.pod<float>();
+            cal.gray_level = in.pod<float>();
+            cal.dsy = in.display();
+            cal.dkl_params = in.pod<dkl::parameter>();
+            cal.dataset = in.str();
+
+            // dumped in order, i.e. newest first
+            cals[key_of(cal.dsy)].emplace_back(name, cal);
+        }
+
+        uint32_t nlinks = in.pod<uint32_t>();
+        for (uint32_t i = 0; i < nlinks; i++) {
+            std::string gfx = in.str();
+            std::string mid = in.str();
+            links[std::make_pair(gfx, mid)] = in.str();
+        }
+
+    } catch (const std::exception &e) {
+        mons.clear();
+        cals.clear();
+        links.clear();
+        stamps[MONITORS].clear();
+        return false;
+    }
+
+    return true;
+}
+
+std::string store::catalog::dump_subjects() const {
+    index_writer out;
+    dump_stamps(out, stamps[SUBJECTS]);
+
+    out.pod(static_cast<uint32_t>(subs.size()));
+    for (const auto &kv : subs) {
+        const subject_entry &entry = kv.second;
+        out.str(kv.first);
+        out.str(entry.info.identifier());
+        out.str(entry.info.initials);
+        out.str(entry.info.name);
+
+        for (const std::vector<fs::file> *files : {&entry.isoslants, &entry.isodata}) {
+            out.pod(static_cast<uint32_t>(files->size()));
+            for (const fs::file &f : *files) {
+                out.str(f.name());
+            }
+        }
+    }
+
+    return out.buf;
+}
+
+bool store::catalog::restore_subjects(const std::string &blob) const {
+    if (blob.empty()) {
+        return false;
+    }
+
+    try {
+        index_reader in(blob);
+        stamps[SUBJECTS] = restore_stamps(in);
+
+        if (!stamps_valid(SUBJECTS)) {
+            stamps[SUBJECTS].clear();
+            return false;
+        }
+
+        uint32_t nsubs = in.pod<uint32_t>();
+        for (uint32_t i = 0; i < nsubs; i++) {
+            std::string uid = in.str();
+            fs::file dir = base.child("subjects/" + uid);
+
+            subject_entry &entry = subs[uid];
+            entry.info = subject(in.str());
+            entry.info.initials = in.str();
+            entry.info.name = in.str();
+
+            for (std::vector<fs::file> *files : {&entry.isoslants, &entry.isodata}) {
+                uint32_t n = in.pod<uint32_t>();
+                for (uint32_t k = 0; k < n; k++) {
+                    files->push_back(dir.child(in.str()));
+                }
+            }
+        }
+
+    } catch (const std::exception &e) {
+        subs.clear();
+        stamps[SUBJECTS].clear();
+        return false;
+    }
+
+    return true;
+}
+
+}
+}
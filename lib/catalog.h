@@ -0,0 +1,135 @@
+#ifndef IRIS_CATALOG_H
+#define IRIS_CATALOG_H
+
+#include <data.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+namespace iris {
+namespace data {
+
+/* In-memory index of a store.
+ *
+ * Two sections, each scanned and parsed once, on first use:
+ *   monitors: monitor descriptions, their settings (newest first),
+ *             the calibrations indexed by display and links.cfg
+ *   subjects: subject descriptions, their isoslants (newest first)
+ *             and isodata files; plus a search index by id, initials
+ *             and name, built on the first search
+ * After that, lookups are map queries. There is one catalog per store
+ * location and process (see shared()); the store write paths add to it,
+ * files written behind its back are only seen after invalidate(), or
+ * as they happen with a store_watcher (watcher.h) calling update().
+ *
+ * Sections are persisted in the binary file catalog.idx at the store
+ * root, together with the mtimes of the directories (and links.cfg)
+ * they were built from. A section whose mtimes all still match is read
+ * from there instead of scanning and parsing YAML; otherwise it is
+ * rebuilt and the index rewritten (atomically; not at all if the store
+ * is read-only). Directory mtimes change when files are added, removed
+ * or replaced via rename (fs::file::write_all), not when a file is
+ * edited in place; invalidate() forces a rebuild.
+ *
+ * All the methods are thread-safe; lookups return copies.
+ */
+class store::catalog {
+public:
+    // monitor, settings, link, gfx
+    typedef std::tuple<std::string, std::string, std::string, std::string> display_key;
+
+    struct monitor_entry {
+        monitor info;
+        std::vector<std::string> settings; // newest first
+    };
+
+    struct subject_entry {
+        subject info;
+        std::vector<fs::file> isoslants;   // newest first
+        std::vector<fs::file> isodata;     // by name
+    };
+
+    explicit catalog(const fs::file &base);
+
+    static std::shared_ptr<catalog> shared(const fs::file &base);
+    static display_key key_of(const display &d);
+
+    // monitors section
+    std::vector<std::string> monitor_ids() const;
+    bool find_monitor(const std::string &uid, monitor_entry &entry) const;
+    bool latest_rgb2lms(const display &d, rgb2lms &cal) const;
+    bool find_link(const std::string &gfx, const std::string &monitor_id, std::string &link) const;
+
+    // subjects section
+    std::vector<subject> subjects() const;
+    bool find_subject(const std::string &uid, subject_entry &entry) const;
+    // subjects whose id, initials or name equal (or start with) phrase, by id
+    std::vector<subject> search_subjects(const std::string &phrase, bool prefix = false) const;
+    std::vector<fs::file> isodata() const;
+
+    // keep up to date with files the store wrote
+    void add_rgb2lms(const fs::file &f, const rgb2lms &cal);
+    void add_subject(const std::string &uid, const subject &s);
+    void add_isoslant(const std::string &subject_id, const fs::file &f);
+    // many at once, saving the index only once: (subject id, file)
+    void add_isoslants(const std::vector<std::pair<std::string, fs::file>> &entries);
+    void add_isodata(const std::string &subject_id, const fs::file &f);
+
+    // a file, relative to the store root, was created, replaced or
+    // removed by someone else; only the affected entry is reloaded.
+    // Removing a directory in monitors/ or subjects/ drops its entries.
+    void update(const std::string &rel, bool removed);
+
+    // drop everything, rescan on next use
+    void invalidate();
+
+private:
+    enum section : int { MONITORS = 0, SUBJECTS = 1 };
+
+    void need_monitors() const;
+    void need_subjects() const;
+    void need_search() const;
+
+    void scan_monitors() const;
+    void scan_subjects() const;
+
+    // add_isoslant with the lock held, false if the subject is unknown
+    bool insert_isoslant(const std::string &subject_id, const fs::file &f);
+
+    // on-disk index
+    void stamp(section s, const std::string &rel) const;
+    bool stamps_valid(section s) const;
+    void read_index() const;
+    void save_index() const;
+    std::string dump_monitors() const;
+    std::string dump_subjects() const;
+    bool restore_monitors(const std::string &blob) const;
+    bool restore_subjects(const std::string &blob) const;
+
+private:
+    fs::file base;
+
+    mutable std::mutex lock;
+
+    mutable bool index_read = false;
+    mutable std::string blobs[2];                     // sections as read from disk
+    mutable std::map<std::string, int64_t> stamps[2]; // relative path -> mtime
+
+    mutable bool have_monitors = false;
+    mutable std::map<std::string, monitor_entry> mons;
+    mutable std::map<display_key, std::vector<std::pair<std::string, rgb2lms>>> cals; // (file name, data), newest first
+    mutable std::map<std::pair<std::string, std::string>, std::string> links;     // (gfx, monitor) -> link
+
+    mutable bool have_subjects = false;
+    mutable std::map<std::string, subject_entry> subs;
+
+    mutable bool have_search = false;
+    mutable std::multimap<std::string, std::string> search; // id, initials, name -> uid
+};
+
+}
+}
+
+#endif
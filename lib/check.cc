@@ -0,0 +1,405 @@
+#include <check.h>
+#include <parallel.h>
+#include <walk.h>
+
+#include <h5x/File.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <set>
+
+#include <sys/stat.h>
+
+namespace iris {
+namespace data {
+
+size_t check_report::errors() const {
+    return std::count_if(problems.begin(), problems.end(), [](const problem &p) {
+        return p.error;
+    });
+}
+
+size_t check_report::warnings() const {
+    return problems.size() - errors();
+}
+
+namespace {
+
+enum class item_kind { monitor, settings, rgb2lms, hdf5, subject, isoslant, isodata };
+
+struct item {
+    item(item_kind kind, const fs::file &file, const std::string &owner)
+            : kind(kind), file(file), owner(owner) { }
+
+    item_kind   kind;
+    fs::file    file;
+    std::string owner;   // monitor or subject directory name
+
+    // filled in by the read
+    bool        ok = false;
+    std::string error;
+    size_t      bytes = 0;
+
+    std::string id;
+    std::string subject;
+    std::string rgb2lms;
+    display     dsy;
+    std::string dataset;
+    bool        has_spectra = false;
+};
+
+size_t file_size(const fs::file &file) {
+    struct stat buf;
+    return stat(file.path().c_str(), &buf) == 0 ? static_cast<size_t>(buf.st_size) : 0;
+}
+
+void read_item(item &it) {
+    switch (it.kind) {
+    case item_kind::monitor: {
+        std::string data = it.file.read_all();
+        it.bytes = data.size();
+        it.id = store::yaml2monitor(data).identifier();
+        break;
+    }
+
+    case item_kind::settings:
+        it.bytes = file_size(it.file);
+        break;
+
+    case item_kind::rgb2lms: {
+        std::string data = it.file.read_all();
+        it.bytes = data.size();
+        rgb2lms cal = store::yaml2rgb2lms(data);
+        it.id = cal.identifier();
+        it.dsy = cal.dsy;
+        it.dataset = cal.dataset;
+        break;
+    }
+
+    case item_kind::hdf5: {
+        it.bytes = file_size(it.file);
+        if (!store::is_hdf5(it.file)) {
+            throw std::runtime_error("not an HDF5 file");
+        }
+        std::lock_guard<std::mutex> guard(h5x::library_lock());
+        h5x::File fd = h5x::File::open(it.file.path(), "r");
+        if (!fd.isValid()) {
+            throw std::runtime_error("not a readable HDF5 file");
+        }
+        it.has_spectra = fd.hasData("spectra") && fd.hasData("patches");
+        fd.close();
+        break;
+    }
+
+    case item_kind::subject: {
+        std::string data = it.file.read_all();
+        it.bytes = data.size();
+        it.id = store::yaml2subject(data).identifier();
+        break;
+    }
+
+    case item_kind::isoslant: {
+        std::string data = it.file.read_all();
+        it.bytes = data.size();
+        isoslant iso = store::yaml2isoslant(data);
+        it.id = iso.identifier();
+        it.subject = iso.subject;
+        it.rgb2lms = iso.rgb2lms;
+        break;
+    }
+
+    case item_kind::isodata: {
+        it.bytes = file_size(it.file);
+        isodata iso = store::load_isodata(it.file);
+        it.id = iso.identifier();
+        it.subject = iso.subject;
+        it.rgb2lms = iso.rgb2lms;
+        if (iso.samples.empty()) {
+            throw std::runtime_error("no samples");
+        }
+        break;
+    }
+    }
+
+    it.ok = true;
+}
+
+}
+
+check_report check_store(const store &store, size_t nthreads) {
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double, std::milli> ms;
+
+    check_report report;
+    const fs::file base = store.location();
+
+    auto problem = [&report](bool error, const fs::file &f, const std::string &msg) {
+        report.problems.push_back(check_report::problem{error, f, msg});
+    };
+
+    // scan: walk monitors/*/ and subjects/*/ in parallel
+
+    auto t0 = clock::now();
+
+    for (const char *top : {"monitors", "subjects"}) {
+        fs::file tdir = base.child(top);
+        if (!tdir.is_directory()) {
+            problem(true, tdir, "missing directory");
+        }
+    }
+
+    std::mutex scan_lock;
+    std::vector<std::pair<std::string, fs::file>> dirs; // (top, dir)
+    std::vector<item> items;
+
+    fs::walk_options wopts;
+    wopts.nthreads = nthreads;
+    wopts.max_depth = 3;
+    wopts.follow_links = true; // symlinked monitor or subject directories
+    wopts.descend = [](const fs::walk_entry &e) {
+        const std::string n = e.file.name();
+        return e.depth > 1 || n == "monitors" || n == "subjects";
+    };
+
+    fs::walk(base, [&](const fs::walk_entry &e) {
+        if (e.depth < 2) {
+            return;
+        }
+
+        const fs::file owner_dir = e.depth == 2 ? e.file : e.file.parent();
+        const std::string top = owner_dir.parent().name();
+        const bool is_monitor = top == "monitors";
+
+        if (e.depth == 2) {
+            if (e.type == fs::file_type::directory) {
+                std::lock_guard<std::mutex> guard(scan_lock);
+                dirs.emplace_back(top, e.file);
+            }
+            return;
+        }
+
+        const std::string owner = owner_dir.name();
+        const std::string n = e.file.name();
+        const std::string ext = e.file.splitext().second;
+
+        item_kind kind;
+        if (is_monitor && n == owner + ".monitor") {
+            kind = item_kind::monitor;
+        } else if (is_monitor && ext == "settings") {
+            kind = item_kind::settings;
+        } else if (is_monitor && ext == "rgb2lms") {
+            kind = item_kind::rgb2lms;
+        } else if (is_monitor && (ext == "h5" || ext == "cac")) {
+            kind = item_kind::hdf5;
+        } else if (!is_monitor && n == owner + ".subject") {
+            kind = item_kind::subject;
+        } else if (!is_monitor && ext == "isoslant") {
+            kind = item_kind::isoslant;
+        } else if (!is_monitor && ext == "isodata") {
+            kind = item_kind::isodata;
+        } else {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(scan_lock);
+        items.emplace_back(kind, e.file, owner);
+    }, wopts);
+
+    // keep reports stable, the walk visits in any order
+    std::sort(items.begin(), items.end(), [](const item &a, const item &b) {
+        return a.file.path() < b.file.path();
+    });
+
+    std::sort(dirs.begin(), dirs.end(), [](const std::pair<std::string, fs::file> &a,
+                                           const std::pair<std::string, fs::file> &b) {
+        return a.second.path() < b.second.path();
+    });
+
+    auto t1 = clock::now();
+
+    // read and parse everything
+
+    H5E_auto2_t h5_handler;
+    void *h5_data;
+    H5Eget_auto2(H5E_DEFAULT, &h5_handler, &h5_data);
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+
+    parallel_for(items.size(), [&items](size_t i, size_t worker) {
+        item &it = items[i];
+        try {
+            read_item(it);
+        } catch (const std::exception &e) {
+            it.ok = false;
+            it.error = e.what();
+        }
+    }, nthreads);
+
+    H5Eset_auto2(H5E_DEFAULT, h5_handler, h5_data);
+
+    auto t2 = clock::now();
+
+    // cross-reference
+
+    std::map<std::string, std::set<std::string>> settings; // monitor -> ids
+    std::set<std::string> monitors;
+    std::set<std::string> subjects;
+    std::map<std::string, fs::file> rgb2lms_ids;
+    std::map<std::string, const item *> h5files;           // path -> item
+    std::set<std::string> isodata_ids;                     // subject/id
+
+    for (const item &it : items) {
+        report.files++;
+        report.bytes += it.bytes;
+
+        if (!it.ok) {
+            problem(true, it.file, "unreadable: " + it.error);
+            continue;
+        }
+
+        switch (it.kind) {
+        case item_kind::monitor:
+            monitors.insert(it.owner);
+            if (it.id != it.owner) {
+                problem(false, it.file, "id [" + it.id + "] differs from the directory name");
+            }
+            break;
+
+        case item_kind::settings:
+            settings[it.owner].insert(it.file.splitext().first);
+            break;
+
+        case item_kind::rgb2lms: {
+            auto res = rgb2lms_ids.emplace(it.id, it.file);
+            if (!res.second) {
+                problem(true, it.file, "duplicate rgb2lms id [" + it.id + "], also in " + res.first->second.path());
+            }
+            break;
+        }
+
+        case item_kind::hdf5:
+            h5files[it.file.path()] = &it;
+            break;
+
+        case item_kind::subject:
+            subjects.insert(it.owner);
+            if (it.id != it.owner) {
+                problem(false, it.file, "id [" + it.id + "] differs from the directory name");
+            }
+            break;
+
+        case item_kind::isodata:
+            isodata_ids.insert(it.owner + "/" + it.id);
+            break;
+
+        case item_kind::isoslant:
+            break;
+        }
+    }
+
+    for (const auto &d : dirs) {
+        const std::string owner = d.second.name();
+        if (d.first == "monitors" && monitors.count(owner) == 0) {
+            problem(true, d.second, "no " + owner + ".monitor description");
+        } else if (d.first == "subjects" && subjects.count(owner) == 0) {
+            problem(true, d.second, "no " + owner + ".subject description");
+        }
+    }
+
+    for (const item &it : items) {
+        if (!it.ok) {
+            continue;
+        }
+
+        if (it.kind == item_kind::rgb2lms) {
+            if (it.dsy.monitor_id != it.owner) {
+                problem(true, it.file, "display monitor [" + it.dsy.monitor_id + "] is not the one it is stored with");
+            } else if (settings[it.owner].count(it.dsy.settings_id) == 0) {
+                problem(false, it.file, "unknown monitor settings [" + it.dsy.settings_id + "]");
+            }
+
+            if (!it.dataset.empty()) {
+                fs::file ds = it.file.parent().child(it.dataset);
+                auto h5 = h5files.find(ds.path());
+                if (!ds.exists()) {
+                    problem(true, it.file, "references missing dataset [" + it.dataset + "]");
+                } else if (h5 != h5files.end() && !h5->second->has_spectra) {
+                    problem(true, it.file, "dataset [" + it.dataset + "] has no spectra and patches");
+                }
+            }
+
+        } else if (it.kind == item_kind::isoslant || it.kind == item_kind::isodata) {
+            if (subjects.count(it.subject) == 0) {
+                problem(true, it.file, "unknown subject [" + it.subject + "]");
+            } else if (it.subject != it.owner) {
+                problem(false, it.file, "belongs to subject [" + it.subject + "], stored with [" + it.owner + "]");
+            }
+
+            if (rgb2lms_ids.count(it.rgb2lms) == 0) {
+                problem(true, it.file, "unknown rgb2lms id [" + it.rgb2lms + "]");
+            }
+
+            if (it.kind == item_kind::isoslant && isodata_ids.count(it.owner + "/" + it.id) == 0) {
+                problem(false, it.file, "no isodata it was fitted from");
+            }
+        }
+    }
+
+    // store root
+
+    fs::file fver = base.child("version");
+    if (!fver.exists()) {
+        problem(true, fver, "missing");
+    }
+
+    for (const char *name : {"default.monitor", "default.font"}) {
+        fs::file link = base.child(name);
+        struct stat buf;
+        if (lstat(link.path().c_str(), &buf) != 0) {
+            problem(!strcmp(name, "default.monitor"), link, "missing");
+        } else if (!link.exists()) {
+            problem(true, link, "dangling link");
+        } else if (!strcmp(name, "default.monitor") && monitors.count(link.readlink().name()) == 0) {
+            problem(true, link, "points to unknown monitor [" + link.readlink().name() + "]");
+        }
+    }
+
+    fs::file linkfile = base.child("links.cfg");
+    if (linkfile.exists()) {
+        try {
+            fs::mapped_file view = linkfile.map();
+            fs::mapped_istream in(view);
+            YAML::Node root = YAML::Load(in);
+            for (const auto &gfx : root) {
+                for (const auto &link : gfx.second) {
+                    std::string mid = link.first.as<std::string>();
+                    if (monitors.count(mid) == 0) {
+                        problem(true, linkfile, "[" + gfx.first.as<std::string>() + "] links unknown monitor [" + mid + "]");
+                    }
+                }
+            }
+        } catch (const std::exception &e) {
+            problem(true, linkfile, std::string("unreadable: ") + e.what());
+        }
+    } else {
+        problem(true, linkfile, "missing");
+    }
+
+    auto t3 = clock::now();
+
+    std::stable_sort(report.problems.begin(), report.problems.end(),
+              [](const check_report::problem &a, const check_report::problem &b) {
+                  return a.file.path() < b.file.path();
+              });
+
+    report.t_scan = ms(t1 - t0).count();
+    report.t_read = ms(t2 - t1).count();
+    report.t_xref = ms(t3 - t2).count();
+
+    return report;
+}
+
+}
+}
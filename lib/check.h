@@ -0,0 +1,44 @@
+#ifndef IRIS_CHECK_H
+#define IRIS_CHECK_H
+
+#include <data.h>
+
+#include <string>
+#include <vector>
+
+namespace iris {
+namespace data {
+
+struct check_report {
+
+    struct problem {
+        bool        error;   // otherwise a warning
+        fs::file    file;
+        std::string message;
+    };
+
+    std::vector<problem> problems;
+
+    size_t files = 0;        // files read
+    size_t bytes = 0;
+
+    double t_scan = 0.0;     // directory enumeration, in ms
+    double t_read = 0.0;     // parsing of all files
+    double t_xref = 0.0;     // cross-referencing
+
+    size_t errors() const;
+    size_t warnings() const;
+};
+
+// Checks the whole store, bypassing the catalog: every description,
+// calibration, isoslant and isodata file is parsed (HDF5 files opened),
+// and the references between them are resolved (default.monitor,
+// links.cfg, rgb2lms datasets and settings, subjects and rgb2lms ids of
+// isoslants and isodata). Directories are enumerated and files read on
+// up to nthreads threads (0: one per core).
+check_report check_store(const store &store, size_t nthreads = 0);
+
+}
+}
+
+#endif
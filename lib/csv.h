@@ -9,7 +9,9 @@
 #include <cstddef>
 #include <string>
 #include <vector>
-#include <fstream>
+#include <algorithm>
+
+#include <fs.h>
 
 namespace iris {
 namespace csv {
@@ -197,14 +199,11 @@ private:
 };
 
 class csv_file {
-    typedef boost::spirit::istream_iterator internal_iter;
-    typedef std::fstream fstream_type;
 public:
-    typedef csv_iterator<internal_iter> iterator;
+    typedef csv_iterator<const char *> iterator;
 
     csv_file(const std::string &path, const char delimiter = '\0')
-            : ifs(path, std::ios::in), delimiter(delimiter) {
-        ifs >> std::noskipws;
+            : view(path), delimiter(delimiter) {
     }
 
     iterator begin() {
@@ -213,40 +212,30 @@ public:
             delimiter = detect_delim();
         }
 
-        boost::spirit::istream_iterator f(ifs), l;
-        return iterator(f, l, delimiter);
+        return iterator(view.begin(), view.end(), delimiter);
     }
 
     iterator end() {
         return iterator();
     }
 
-    const char detect_delim(const std::string dknown = ",;\t") {
-
-        auto pos = ifs.tellg();
-        ifs.clear();
-        ifs.seekg(0, std::ios::beg);
+    const char detect_delim(const std::string dknown = ",;\t") const {
 
         std::vector<size_t> dcount(dknown.size(), 0);
 
-        for (std::string line; std::getline(ifs, line);) {
-            for(size_t i = 0; i < dknown.size(); i++) {
-                dcount[i] += std::count(line.begin(), line.end(), dknown[i]);
-            }
+        for(size_t i = 0; i < dknown.size(); i++) {
+            dcount[i] = std::count(view.begin(), view.end(), dknown[i]);
         }
 
         auto imax = std::max_element(dcount.begin(), dcount.end());
         auto p = std::distance(dcount.begin(), imax);
 
-        ifs.clear();
-        ifs.seekg(pos);
-
         return dknown[p];
     }
 
 private:
-    fstream_type ifs;
-    fstream_type::char_type delimiter;
+    fs::mapped_file view;
+    char delimiter;
 };
 
 } // iris::
@@ -1,8 +1,16 @@
 #include <data.h>
+#include <catalog.h>
 #include <yaml-cpp/yaml.h>
 #include <csv.h>
 #include <misc.h>
 
+#include <h5x/File.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <unistd.h>
+
 #define CUR_VERSION "1.0"
 
 namespace iris {
@@ -50,7 +58,7 @@ iris::data::store iris::data::store::default_store() {
 }
 
 
-iris::data::store::store(const fs::file &path) : base(path) {
+iris::data::store::store(const fs::file &path) : base(path), cat(catalog::shared(path)) {
 
 }
 
@@ -80,25 +88,16 @@ std::string iris::data::store::default_monitor() const {
 
 
 std::vector<std::string> store::list_monitors() const {
-    fs::file mdir = base.child("monitors");
-
-    std::vector<fs::file> res;
-    std::copy_if(mdir.children().begin(), mdir.children().end(), std::back_inserter(res), [](const fs::file &f){
-        fs::file mfile = f.child("/" + f.name() + ".monitor");
-        return mfile.exists();
-    });
-
-    std::vector<std::string> names(res.size());
-    std::transform(res.begin(), res.end(), names.begin(), [](const fs::file &f){
-        return f.name();
-    });
-
-    return names;
+    return cat->monitor_ids();
 }
 
 iris::data::monitor iris::data::store::load_monitor(const std::string &uid) const {
-    fs::file mfs = base.child("monitors/" + uid + "/" + uid + ".monitor");
-    return yaml2monitor(mfs.read_all());
+    catalog::monitor_entry entry;
+    if (!cat->find_monitor(uid, entry)) {
+        throw std::runtime_error("cfg: unknown monitor [" + uid + "]");
+    }
+
+    return entry.info;
 }
 
 
@@ -112,56 +111,20 @@ std::string store::latest_settings(const monitor &monitor) const {
 }
 
 std::vector<std::string> store::list_settings(const monitor &monitor) const {
+    catalog::monitor_entry entry;
+    if (!cat->find_monitor(monitor.qualified_id(), entry)) {
+        return std::vector<std::string>();
+    }
 
-    fs::file mdir = base.child("monitors/" + monitor.qualified_id());
-
-    std::vector<fs::file> res;
-    std::copy_if(mdir.children().begin(), mdir.children().end(),
-                 std::back_inserter(res), fs::fn_matcher("*.settings"));
-
-    std::sort(res.begin(), res.end(), [](const fs::file &a, const fs::file &b) {
-        return a.name() > b.name();
-    });
-
-    std::vector<std::string> ids;
-    std::transform(res.begin(), res.end(), std::back_inserter(ids), [](const fs::file &f) {
-        std::string name = f.name();
-        size_t len = name.size();
-        name.erase(len - 9, 9); // we matched for "*.settings"
-        return name;
-    });
-
-    return ids;
+    return entry.settings;
 }
 
 rgb2lms store::load_rgb2lms(const display &display) const {
 
-    // need to find the latest calibration that fits the display
-
-    fs::file mdir = base.child("monitors/" + display.monitor_id);
-
-    std::vector<fs::file> res;
-    std::copy_if(mdir.children().begin(), mdir.children().end(),
-              std::back_inserter(res), fs::fn_matcher("*.rgb2lms"));
-
-    std::sort(res.begin(), res.end(), [](const fs::file &a, const fs::file &b) {
-        return a.name() > b.name();
-    });
-
-    for (const fs::file f : res) {
-        std::string data = f.read_all();
-        rgb2lms ca = yaml2rgb2lms(data);
-
-        const struct display &d = ca.dsy;
-
-        if (d.monitor_id  == display.monitor_id &&
-            d.settings_id == display.settings_id &&
-            d.link_id     == display.link_id &&
-            d.gfx         == display.gfx) {
-
-            //FIXME:: check mode too
-            return ca;
-        }
+    // the latest calibration that fits the display
+    rgb2lms ca;
+    if (cat->latest_rgb2lms(display, ca)) {
+        return ca;
     }
 
     throw std::runtime_error("Could not find any matching rgb2lms matrix ["
@@ -188,67 +151,54 @@ fs::file store::store_rgb2lms(const rgb2lms &rgb2lms) {
     }
 
     std::string data = rgb2lms2yaml(rgb2lms);
-    fd.write_all(data);
+    fd.atomic_write(data);
+
+    cat->add_rgb2lms(fd, rgb2lms);
 
     return fd;
 }
 
 subject store::load_subject(const std::string &uid) {
-    fs::file sfile = base.child("subjects/" + uid + "/" + uid + ".subject");
-    return yaml2subject(sfile.read_all());
-}
+    catalog::subject_entry entry;
+    if (!cat->find_subject(uid, entry)) {
+        throw std::runtime_error("cfg: unknown subject [" + uid + "]");
+    }
 
+    return entry.info;
+}
 
-std::vector<iris::data::subject> store::find_subjects(const std::string &phrase) {
-    fs::file sdir = base.child("subjects");
 
-    std::vector<fs::file> res;
-    std::copy_if(sdir.children().begin(), sdir.children().end(),
-                 std::back_inserter(res),
-                 [](const fs::file &f) {
-                     const std::string &n = f.name();
-                     if (n == "." || n == ".." || ! f.is_directory()) {
-                         return false;
-                     }
+fs::file store::store_subject(const subject &subject) {
+    const std::string uid = subject.identifier();
+    fs::file sdir = base.child("subjects/" + uid);
 
-                     fs::file sf = f.child(n + ".subject");
-                     return sf.exists();
-                 });
+    if (!sdir.exists()) {
+        sdir.mkdir_with_parents();
+    }
 
-    std::vector<subject> subjects;
-    std::transform(res.cbegin(), res.cend(), std::back_inserter(subjects),
-                   [this](const fs::file &f) {
-                       return load_subject(f.name());
-                   });
+    fs::file fd = sdir.child(uid + ".subject");
+    fd.atomic_write(subject2yaml(subject));
 
-    std::vector<subject> hits;
-    std::copy_if(subjects.cbegin(), subjects.cend(), std::back_inserter(hits),
-                 [&phrase](const subject &s) {
-                     return s.name == phrase ||
-                            s.initials == phrase ||
-                            s.identifier() == phrase ||
-                            s.qualified_id() == phrase;
-                 });
+    cat->add_subject(uid, subject);
 
-    return hits;
+    return fd;
 }
 
-isoslant store::load_isoslant(const subject &subject) {
-    fs::file sdir = base.child("subjects/" + subject.identifier());
-
-    std::vector<fs::file> res;
-    std::copy_if(sdir.children().begin(), sdir.children().end(),
-                 std::back_inserter(res), fs::fn_matcher("*.isoslant"));
+std::vector<iris::data::subject> store::find_subjects(const std::string &phrase, bool prefix) {
+    return cat->search_subjects(phrase, prefix);
+}
 
-    std::sort(res.begin(), res.end(), [](const fs::file &a, const fs::file &b) {
-        return a.name() > b.name();
-    });
+std::vector<fs::file> store::list_isodata() const {
+    return cat->isodata();
+}
 
-    if (res.empty()) {
+isoslant store::load_isoslant(const subject &subject) {
+    catalog::subject_entry entry;
+    if (!cat->find_subject(subject.identifier(), entry) || entry.isoslants.empty()) {
         throw std::runtime_error("Could not find isoslant for subject");
     }
 
-    fs::file sfile = res.front();
+    fs::file sfile = entry.isoslants.front();
     return yaml2isoslant(sfile.read_all());
 }
 
@@ -256,15 +206,10 @@ display store::make_display(const monitor       &monitor,
                             const monitor::mode &mode,
                             const std::string   &gfx) const
 {
-
-    fs::file linkfile = base.child("links.cfg");
-    std::string data = linkfile.read_all();
-    YAML::Node root = YAML::Load(data);
-
-    YAML::Node gfx_node = root[gfx];
-    YAML::Node link_node = gfx_node[monitor.identifier()];
-
-    std::string link_id = link_node.as<std::string>();
+    std::string link_id;
+    if (!cat->find_link(gfx, monitor.identifier(), link_id)) {
+        throw std::runtime_error("cfg: no link for [" + gfx + ", " + monitor.identifier() + "] in links.cfg");
+    }
 
     display dsp;
     dsp.link_id = link_id;
@@ -276,9 +221,9 @@ display store::make_display(const monitor       &monitor,
     return dsp;
 }
 
-
-
-// yaml stuff
+void store::refresh() const {
+    cat->invalidate();
+}
 
 fs::file store::cone_fundamentals(size_t spacing) const {
     std::stringstream fn;
@@ -286,6 +231,47 @@ fs::file store::cone_fundamentals(size_t spacing) const {
     return base.child(fn.str());
 }
 
+bool store::load_cached(const std::string &kind, const std::string &key, std::string &data) const {
+    fs::file entry = base.child("cache/" + kind + "/" + key);
+
+    if (!entry.exists()) {
+        return false;
+    }
+
+    data = entry.read_all();
+    return true;
+}
+
+void store::store_cached(const std::string &kind, const std::string &key, const std::string &data) const {
+    fs::file dir = base.child("cache/" + kind);
+
+    if (!dir.exists()) {
+        dir.mkdir_with_parents();
+    }
+
+    // write_all is atomic, concurrent writers of the same key are fine
+    fs::file entry = dir.child(key);
+    entry.write_all(data);
+}
+
+size_t store::clear_cache() const {
+    fs::file cdir = base.child("cache");
+    if (!cdir.is_directory()) {
+        return 0;
+    }
+
+    size_t removed = 0;
+    for (const fs::file &kind : cdir.children("", fs::file_type::directory)) {
+        for (const fs::file &entry : kind.children("", fs::file_type::regular)) {
+            removed += entry.remove() ? 1 : 0;
+        }
+    }
+
+    return removed;
+}
+
+// yaml stuff
+
 static iris::data::monitor::mode yaml2mode(const YAML::Node &node) {
     iris::data::monitor::mode mode;
 
@@ -475,6 +461,17 @@ isoslant store::yaml2isoslant(const std::string &data) {
     iso.rgb2lms = root["rgb2lms"].as<std::string>();
 
     iso.display = yaml2display(root["display"]);
+
+    YAML::Node ci = root["ci"];
+    if (ci) {
+        iso.ci_level = ci["level"].as<double>();
+        iso.ci_samples = ci["samples"].as<size_t>();
+        iso.dl_ci.lower = ci["dl"][0].as<double>();
+        iso.dl_ci.upper = ci["dl"][1].as<double>();
+        iso.phi_ci.lower = ci["phi"][0].as<double>();
+        iso.phi_ci.upper = ci["phi"][1].as<double>();
+    }
+
     return iso;
 }
 
@@ -490,6 +487,15 @@ std::string store::isoslant2yaml(const isoslant &iso) {
     out << "dl" << iso.dl;
     out << "phi" << iso.phi;
 
+    if (iso.ci_level > 0.0) {
+        out << "ci" << YAML::BeginMap;
+        out << "level" << iso.ci_level;
+        out << "samples" << iso.ci_samples;
+        out << "dl" << YAML::Flow << YAML::BeginSeq << iso.dl_ci.lower << iso.dl_ci.upper << YAML::EndSeq;
+        out << "phi" << YAML::Flow << YAML::BeginSeq << iso.phi_ci.lower << iso.phi_ci.upper << YAML::EndSeq;
+        out << YAML::EndMap; // ci
+    }
+
     out << "display";
     emit_display(iso.display, out);
     out << "rgb2lms" << iso.rgb2lms;
@@ -501,10 +507,9 @@ std::string store::isoslant2yaml(const isoslant &iso) {
 }
 
 
-isodata store::yaml2isodata(const std::string &str) {
+static isodata isodata_from_node(const YAML::Node &doc) {
     typedef csv_iterator<std::string::const_iterator> csv_siterator;
 
-    YAML::Node doc = YAML::Load(str);
     YAML::Node root = doc["isodata"];
 
     isodata d(root["id"].as<std::string>());
@@ -512,6 +517,10 @@ isodata store::yaml2isodata(const std::string &str) {
     d.display = yaml2display(root["display"]);
     d.rgb2lms = root["rgb2lms"].as<std::string>();
 
+    if (!root["data"]) {
+        return d; // metadata only (HDF5 isodata)
+    }
+
     std::string cd = root["data"].as<std::string>();
 
     bool is_header = true;
@@ -542,7 +551,11 @@ isodata store::yaml2isodata(const std::string &str) {
     return d;
 }
 
-std::string store::isodata2yaml(const isodata &data) {
+isodata store::yaml2isodata(const std::string &str) {
+    return isodata_from_node(YAML::Load(str));
+}
+
+static std::string emit_isodata(const isodata &data, bool with_samples) {
     YAML::Emitter out;
 
     out << YAML::BeginMap;
@@ -555,21 +568,104 @@ std::string store::isodata2yaml(const isodata &data) {
     emit_display(data.display, out);
     out << "rgb2lms" << data.rgb2lms;
 
-    out << "data" << YAML::Literal;
+    if (with_samples) {
+        out << "data" << YAML::Literal;
 
-    std::stringstream cd;
+        std::stringstream cd;
 
-    cd << "stimulus, response";
-    for (const isodata::sample &s : data.samples) {
-        cd << std::endl;
-        cd << s.stimulus << ", " << s.response;
+        cd << "stimulus, response";
+        for (const isodata::sample &s : data.samples) {
+            cd << std::endl;
+            cd << s.stimulus << ", " << s.response;
+        }
+        out << cd.str();
     }
-    out << cd.str();
 
     out << YAML::EndMap;
     out << YAML::EndMap;
 
     return std::string(out.c_str());
 }
+
+std::string store::isodata2yaml(const isodata &data) {
+    return emit_isodata(data, true);
+}
+
+bool store::is_hdf5(const fs::file &file) {
+    static const char signature[8] = {'\x89', 'H', 'D', 'F', '\r', '\n', '\x1a', '\n'};
+
+    char head[8];
+    std::ifstream in(file.path(), std::ios::binary);
+    return in.read(head, sizeof(head)) && std::memcmp(head, signature, sizeof(head)) == 0;
+}
+
+isodata store::load_isodata(const fs::file &file) {
+    if (!is_hdf5(file)) {
+        // parse straight from the mapping, legacy files can be large
+        fs::mapped_file view = file.map();
+        fs::mapped_istream in(view);
+        return isodata_from_node(YAML::Load(in));
+    }
+
+    std::lock_guard<std::mutex> guard(h5x::library_lock());
+    h5x::File fd = h5x::File::open(file.path(), "r");
+
+    std::string meta;
+    if (!fd.getAttr("metadata", meta)) {
+        throw std::runtime_error("isodata: no metadata in " + file.path());
+    }
+
+    isodata d = yaml2isodata(meta);
+
+    std::vector<float> stimulus, response;
+    if (!fd.getData("stimulus", stimulus) || !fd.getData("response", response) ||
+        stimulus.size() != response.size()) {
+        throw std::runtime_error("isodata: invalid sample data in " + file.path());
+    }
+
+    d.samples.resize(stimulus.size());
+    for (size_t i = 0; i < stimulus.size(); i++) {
+        d.samples[i] = isodata::sample(stimulus[i], response[i]);
+    }
+
+    fd.getData("timestamp", d.timestamps);
+    fd.close();
+
+    return d;
+}
+
+void store::save_isodata(const isodata &data, const fs::file &file) {
+    if (!data.timestamps.empty() && data.timestamps.size() != data.samples.size()) {
+        throw std::invalid_argument("isodata: need one timestamp per sample");
+    }
+
+    std::vector<float> stimulus(data.samples.size());
+    std::vector<float> response(data.samples.size());
+    for (size_t i = 0; i < data.samples.size(); i++) {
+        stimulus[i] = data.samples[i].stimulus;
+        response[i] = data.samples[i].response;
+    }
+
+    // written next to the destination, then renamed over it
+    fs::file tmp = file.parent().child("." + file.name() + "." + std::to_string(getpid()));
+
+    try {
+        std::lock_guard<std::mutex> guard(h5x::library_lock());
+        h5x::File fd = h5x::File::open(tmp.path(), "w");
+        fd.check("isodata: could not create " + tmp.path());
+        fd.setAttr("metadata", emit_isodata(data, false));
+        fd.setData("stimulus", stimulus);
+        fd.setData("response", response);
+        if (!data.timestamps.empty()) {
+            fd.setData("timestamp", data.timestamps);
+        }
+        fd.close();
+    } catch (...) {
+        tmp.remove();
+        throw;
+    }
+
+    tmp.durable_rename(file);
+}
 } //iris::cfg::
 } //iris::
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <memory>
 
 #include <dkl.h>
 #include <fs.h>
@@ -104,6 +105,7 @@ struct isodata : entity {
     std::string subject; //the id
 
     std::vector<sample> samples;
+    std::vector<double> timestamps; // per sample, s since the start; optional
 
     //provenance metadata
     data::display display;
@@ -118,6 +120,17 @@ struct isoslant : entity {
     double dl;
     double phi;
 
+    //uncertainty (bootstrap percentile intervals), optional
+    struct interval {
+        double lower;
+        double upper;
+    };
+
+    double   ci_level = 0.0; // 0 if not present
+    size_t   ci_samples = 0;
+    interval dl_ci;
+    interval phi_ci;
+
     //provenance metadata
     data::display display;
     std::string rgb2lms;
@@ -137,6 +150,7 @@ struct isoslant : entity {
 
 class store {
 public:
+    class catalog; // catalog.h
 
     static store default_store();
 
@@ -157,14 +171,30 @@ public:
 
     //subject functions
     subject load_subject(const std::string &uid);
+    fs::file store_subject(const subject &subject);
     isoslant load_isoslant(const subject &subject);
-    std::vector<iris::data::subject> find_subjects(const std::string &pharse);
+    // match on id, initials or name; exactly or, with prefix, by prefix
+    std::vector<iris::data::subject> find_subjects(const std::string &pharse, bool prefix = false);
+    std::vector<fs::file> list_isodata() const;
 
     display make_display(const monitor &monitor, const monitor::mode &mode, const std::string &gfx) const;
 
+    // content-addressed cache of fit results, kept in cache/<kind>/<key>;
+    // the key is a digest of everything the result depends on, so changed
+    // inputs or options simply miss. load_cached returns false on a miss.
+    bool load_cached(const std::string &kind, const std::string &key, std::string &data) const;
+    void store_cached(const std::string &kind, const std::string &key, const std::string &data) const;
+    size_t clear_cache() const;
+
     // cone fundamentals for calibration
     fs::file cone_fundamentals(size_t spacing = 4) const;
 
+    // the in-memory index behind the lookups above, shared by all
+    // store objects of the same location in the process
+    catalog &index() const { return *cat; }
+    // rescan on the next lookup, for files written behind our back
+    void refresh() const;
+
     // yaml config IO
 
     static monitor yaml2monitor(const std::string &data);
@@ -180,11 +210,24 @@ public:
     static isodata     yaml2isodata(const std::string &data);
     static std::string isodata2yaml(const isodata &data);
 
+    // isodata files are either YAML, with the samples as inline CSV, or
+    // HDF5, with the samples as (chunked) stimulus, response and timestamp
+    // datasets and the rest as YAML in the "metadata" attribute; load
+    // tells them apart by content, save writes HDF5. Both hold
+    // h5x::library_lock() while using HDF5 and may be called from
+    // several threads.
+    static isodata     load_isodata(const fs::file &file);
+    static void        save_isodata(const isodata &data, const fs::file &file);
+
+    // whether the file starts with the HDF5 signature; reads 8 bytes
+    static bool        is_hdf5(const fs::file &file);
+
 private:
     store(const fs::file &path);
 
 private:
     fs::file base;
+    std::shared_ptr<catalog> cat;
 };
 
 } //iris::cfg
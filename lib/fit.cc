@@ -1,54 +1,488 @@
 
 #include <fit.h>
+#include <parallel.h>
+#include <lm.h>
 
 #include <cminpack-1/cminpack.h>
 #include <iostream>
+#include <limits>
+#include <numeric>
 
 namespace iris {
 
-static int call_opt(void *p,
-                    int m,
-                    int n,
-                    const double *x,
-                    double *fvec,
-                    int iflag)
-{
-    fitter *opt = static_cast<fitter *>(p);
-    return opt->eval(m, n, x, fvec);
-}
+struct fitter_callback {
+
+    static int call_opt(void *p,
+                        int m,
+                        int n,
+                        const double *x,
+                        double *fvec,
+                        int iflag)
+    {
+        fitter *opt = static_cast<fitter *>(p);
+        opt->n_eval++;
+        return opt->eval(m, n, x, fvec);
+    }
+
+    static int call_der(void *p,
+                        int m,
+                        int n,
+                        const double *x,
+                        double *fvec,
+                        double *fjac,
+                        int ldfjac,
+                        int iflag)
+    {
+        fitter *opt = static_cast<fitter *>(p);
+
+        if (iflag == 2) {
+            opt->n_jac++;
+            return opt->jacobian(m, n, x, fjac, ldfjac);
+        }
+
+        opt->n_eval++;
+        return opt->eval(m, n, x, fvec);
+    }
+};
 
 
 bool fitter::operator()() {
     double tol = tolerance();
     const int m = num_variables();
     const int n = num_parameter();
-    const int lwa = m*n+5*n+m;
+
+    if (m <= 0 || n <= 0) {
+        fit_info = 0; // improper input, as minpack would say
+        return false;
+    }
+
     std::vector<int> iwa(n);
-    std::vector<double> wa(lwa);
     std::vector<double> fvec(m);
 
     double *p = params();
     void *user_data = static_cast<void *>(this);
-    fit_info = lmdif1(call_opt, user_data, m, n, p, fvec.data(), tol, iwa.data(), wa.data(), lwa);
+
+    n_eval = n_jac = 0;
+
+    if (with_jacobian && has_jacobian()) {
+        const int lwa = 5*n+m;
+        std::vector<double> wa(lwa);
+        std::vector<double> fjac(static_cast<size_t>(m) * static_cast<size_t>(n));
+        fit_info = lmder1(fitter_callback::call_der, user_data, m, n, p, fvec.data(),
+                          fjac.data(), m, tol, iwa.data(), wa.data(), lwa);
+    } else {
+        const int lwa = m*n+5*n+m;
+        std::vector<double> wa(lwa);
+        fit_info = lmdif1(fitter_callback::call_opt, user_data, m, n, p, fvec.data(),
+                          tol, iwa.data(), wa.data(), lwa);
+    }
+
+    fit_residual = std::inner_product(fvec.cbegin(), fvec.cend(), fvec.cbegin(), 0.0);
     return fit_info == 1 || fit_info == 2 || fit_info == 3;
 }
 
+multistart_result multistart::operator()(const std::vector<std::vector<double>> &starts,
+                                         size_t nthreads) const {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    multistart_result res;
+    res.residuals.assign(starts.size(), nan);
+
+    std::vector<std::vector<double>> params(starts.size());
+
+    parallel_for(starts.size(), [&](size_t i, size_t worker) {
+        std::unique_ptr<fitter> fit = make();
+        const std::vector<double> &start = starts[i];
+
+        if (static_cast<int>(start.size()) != fit->num_parameter()) {
+            throw std::invalid_argument("start has wrong number of parameters");
+        }
+
+        double *p = fit->params();
+        std::copy(start.cbegin(), start.cend(), p);
+
+        if ((*fit)()) {
+            res.residuals[i] = fit->residual();
+            params[i].assign(p, p + start.size());
+        }
+    }, nthreads);
+
+    res.converged = 0;
+    res.residual = nan;
+    for (size_t i = 0; i < starts.size(); i++) {
+        if (std::isnan(res.residuals[i])) {
+            continue;
+        }
+
+        if (res.converged++ == 0 || res.residuals[i] < res.residual) {
+            res.residual = res.residuals[i];
+            res.params = params[i];
+        }
+    }
+
+    return res;
+}
+
+std::vector<double> resample_result::column(size_t k) const {
+    std::vector<double> res(params.size());
+    std::transform(params.cbegin(), params.cend(), res.begin(), [k](const std::vector<double> &p) {
+        return p[k];
+    });
+    return res;
+}
+
+template<typename F>
+resample_result resampler::refit(size_t n, size_t nthreads, F select) const {
+
+    if (nthreads == 0) {
+        nthreads = hardware_threads();
+    }
+
+    // sample buffers are reused by all the refits of a worker
+    struct workspace {
+        std::vector<double> x;
+        std::vector<double> y;
+    };
+
+    std::vector<workspace> ws(nthreads);
+    std::vector<std::vector<double>> params(n);
+
+    parallel_for(n, [&](size_t i, size_t worker) {
+        workspace &w = ws[worker];
+        w.x.clear();
+        w.y.clear();
+
+        select(i, w.x, w.y);
+
+        std::unique_ptr<fitter> fit = make(w.x, w.y);
+        if ((*fit)()) {
+            const double *p = fit->params();
+            params[i].assign(p, p + fit->num_parameter());
+        }
+    }, nthreads);
+
+    resample_result res;
+    res.replicates = n;
+    for (std::vector<double> &p : params) {
+        if (!p.empty()) {
+            res.params.push_back(std::move(p));
+        }
+    }
+    res.failed = n - res.params.size();
+
+    return res;
+}
+
+resample_result resampler::bootstrap(size_t n, unsigned int seed, size_t nthreads) const {
+    const size_t m = x.size();
+
+    return refit(n, nthreads, [&](size_t i, std::vector<double> &bx, std::vector<double> &by) {
+        std::seed_seq sseq{seed, static_cast<unsigned int>(i)};
+        std::mt19937 rnd_gen(sseq);
+        std::uniform_int_distribution<size_t> pick(0, m - 1);
+
+        for (size_t k = 0; k < m; k++) {
+            size_t j = pick(rnd_gen);
+            bx.push_back(x[j]);
+            by.push_back(y[j]);
+        }
+    });
+}
+
+resample_result resampler::jackknife(size_t nthreads) const {
+    const size_t m = x.size();
+
+    return refit(m, nthreads, [&](size_t i, std::vector<double> &jx, std::vector<double> &jy) {
+        for (size_t k = 0; k < m; k++) {
+            if (k != i) {
+                jx.push_back(x[k]);
+                jy.push_back(y[k]);
+            }
+        }
+    });
+}
+
+std::pair<double, double> resampler::percentile(std::vector<double> values, double level) {
+    if (values.empty()) {
+        throw std::invalid_argument("no values for percentile");
+    }
+
+    if (!(level > 0.0 && level < 1.0)) {
+        throw std::invalid_argument("percentile level must be in (0, 1)");
+    }
+
+    std::sort(values.begin(), values.end());
+
+    auto at = [&values](double q) {
+        double pos = q * (values.size() - 1);
+        size_t lo = static_cast<size_t>(std::floor(pos));
+        size_t hi = std::min(lo + 1, values.size() - 1);
+        double frac = pos - lo;
+        return values[lo] + frac * (values[hi] - values[lo]);
+    };
+
+    const double alpha = (1.0 - level) * 0.5;
+    return std::make_pair(at(alpha), at(1.0 - alpha));
+}
+
+double resampler::jackknife_se(const std::vector<double> &values) {
+    const double n = values.size();
+    if (n < 2) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    const double mean = std::accumulate(values.cbegin(), values.cend(), 0.0) / n;
+
+    double ss = 0.0;
+    for (double v : values) {
+        ss += (v - mean) * (v - mean);
+    }
+
+    return std::sqrt((n - 1.0) / n * ss);
+}
+
 int gamma_fitter::eval(int m, int n, const double *p, double *fvec) const {
     if (n != 3 || m != static_cast<int>(x.size())) {
         throw std::invalid_argument("Invalid data passed to GF");
     }
 
+    const double Azero = p[0];
+    const double A = p[1];
+    const double gamma = p[2];
+
+    vmath::exp_ax(logx.data(), gamma, xg.data(), xg.size());
+
+    for (int i = 0; i < m; i++) {
+        fvec[i] = y[i] - (Azero + A * xg[i]);
+    }
+
+    return 0;
+}
+
+int gamma_fitter::jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const {
+    if (n != 3 || m != static_cast<int>(x.size())) {
+        throw std::invalid_argument("Invalid data passed to GF");
+    }
+
+    const double A = p[1];
+    const double gamma = p[2];
+
+    vmath::exp_ax(logx.data(), gamma, xg.data(), xg.size());
+
     for (int i = 0; i < m; i++) {
-        const double Azero = p[0];
-        const double A = p[1];
-        const double gamma = p[2];
+        const double lx = x[i] > 0.0 ? logx[i] : 0.0;
 
-        fvec[i] = y[i] - func(Azero, A, gamma, x[i]);
+        fjac[i] = -1.0;
+        fjac[i + ldfjac] = -xg[i];
+        fjac[i + 2*ldfjac] = -A * xg[i] * lx;
     }
 
     return 0;
 }
 
+bool sin_fitter::operator()() {
+    bool have_linear = linear_fit();
+
+    if (have_linear && !fit_frequency) {
+        return true;
+    }
+
+    // the small fixed-size solver does not allocate once the
+    // per-thread workspace is warm (bootstrap and batch fits)
+    static thread_local lm_workspace ws;
+    lm_solver<4> lm;
+    lm.tol = tolerance();
+
+    bool res = lm(*this, ws);
+
+    fit_info = res ? 1 : (lm.valid_input() ? 5 : 0);
+    n_eval = lm.evaluations();
+    n_jac = lm.jacobian_evaluations();
+    fit_residual = lm.residual();
+
+    return res;
+}
+
+// Gauss-Jordan with partial pivoting on the k x k normal equations
+// N sol = rhs; also yields N^-1 (when inv != nullptr), which scaled by
+// the residual variance is the covariance of the solution.
+// Returns false if N is (numerically) singular.
+static bool solve_normal(const double N[3][3], const double rhs[3], int k, double sol[3], double inv[3][3]) {
+    double M[3][7]; // [N | I | rhs]
+    for (int r = 0; r < k; r++) {
+        for (int c = 0; c < k; c++) {
+            M[r][c] = N[r][c];
+            M[r][k + c] = r == c ? 1.0 : 0.0;
+        }
+        M[r][2*k] = rhs[r];
+    }
+
+    const int w = 2*k + 1;
+    const double eps = 1e-12 * (N[0][0] + N[1][1]);
+    for (int c = 0; c < k; c++) {
+        int pivot = c;
+        for (int r = c + 1; r < k; r++) {
+            if (std::abs(M[r][c]) > std::abs(M[pivot][c])) {
+                pivot = r;
+            }
+        }
+
+        if (!(std::abs(M[pivot][c]) > eps)) {
+            return false; // singular, e.g. all x identical
+        }
+
+        std::swap(M[c], M[pivot]);
+
+        const double d = M[c][c];
+        for (int j = c; j < w; j++) {
+            M[c][j] /= d;
+        }
+
+        for (int r = 0; r < k; r++) {
+            if (r == c) {
+                continue;
+            }
+            const double f = M[r][c];
+            for (int j = c; j < w; j++) {
+                M[r][j] -= f * M[c][j];
+            }
+        }
+    }
+
+    for (int r = 0; r < k; r++) {
+        sol[r] = M[r][2*k];
+        if (inv != nullptr) {
+            for (int c = 0; c < k; c++) {
+                inv[r][c] = M[r][k + c];
+            }
+        }
+    }
+
+    return true;
+}
+
+bool sin_fitter::linear_fit() {
+    // normal equations for y - dc = a cos x + b sin x [+ c]
+    const int k = fit_offset ? 3 : 2;
+    double N[3][3] = {{0.0, }, };
+    double rhs[3] = {0.0, };
+
+    for (size_t i = 0; i < x.size(); i++) {
+        const double basis[3] = {cos(x[i]), sin(x[i]), 1.0};
+        const double target = fit_offset ? y[i] : y[i] - dc;
+
+        for (int r = 0; r < k; r++) {
+            for (int c = 0; c < k; c++) {
+                N[r][c] += basis[r] * basis[c];
+            }
+            rhs[r] += basis[r] * target;
+        }
+    }
+
+    double sol[3];
+    if (!solve_normal(N, rhs, k, sol, nullptr)) {
+        return false;
+    }
+
+    p[0] = std::hypot(sol[0], sol[1]);
+    p[1] = std::atan2(sol[1], sol[0]);
+
+    if (fit_offset) {
+        p[2] = sol[2];
+    }
+
+    p[freq_idx] = 1.0;
+
+    std::vector<double> fvec(x.size());
+    eval(num_variables(), num_parameter(), p, fvec.data());
+
+    fit_info = 1;
+    n_eval = 1;
+    n_jac = 0;
+    fit_residual = std::inner_product(fvec.cbegin(), fvec.cend(), fvec.cbegin(), 0.0);
+
+    return true;
+}
+
+sin_estimator::sin_estimator(double offset)
+        : fit_offset(offset < 0), dc(fit_offset ? 0.0 : offset) {
+    reset();
+}
+
+void sin_estimator::reset() {
+    n = 0;
+    std::fill(&xtx[0][0], &xtx[0][0] + 9, 0.0);
+    std::fill(xty, xty + 3, 0.0);
+    yty = 0.0;
+
+    solved = false;
+    A = phi = 0.0;
+    c = dc;
+    sigma2 = se_A = se_phi = se_c = std::numeric_limits<double>::infinity();
+}
+
+bool sin_estimator::add(double x, double y) {
+    const int k = fit_offset ? 3 : 2;
+    const double basis[3] = {std::cos(x), std::sin(x), 1.0};
+    const double target = fit_offset ? y : y - dc;
+
+    for (int r = 0; r < k; r++) {
+        for (int col = 0; col < k; col++) {
+            xtx[r][col] += basis[r] * basis[col];
+        }
+        xty[r] += basis[r] * target;
+    }
+    yty += target * target;
+    n++;
+
+    double sol[3];
+    double inv[3][3];
+    if (n < static_cast<size_t>(k) || !solve_normal(xtx, xty, k, sol, inv)) {
+        return solved = false;
+    }
+
+    const double a = sol[0];
+    const double b = sol[1];
+
+    A = std::hypot(a, b);
+    phi = std::atan2(b, a);
+    c = fit_offset ? sol[2] : dc;
+
+    if (n > static_cast<size_t>(k)) {
+        // RSS = y^T y - sol^T X^T y at the least-squares solution
+        double rss = yty;
+        for (int r = 0; r < k; r++) {
+            rss -= sol[r] * xty[r];
+        }
+        sigma2 = std::max(rss, 0.0) / static_cast<double>(n - k);
+
+        // first order propagation of cov(a, b) to (A, phi)
+        const double vaa = sigma2 * inv[0][0];
+        const double vbb = sigma2 * inv[1][1];
+        const double vab = sigma2 * inv[0][1];
+
+        if (A > 0.0) {
+            const double A2 = A * A;
+            se_A = std::sqrt(std::max(0.0, (a*a*vaa + 2.0*a*b*vab + b*b*vbb) / A2));
+            se_phi = std::sqrt(std::max(0.0, (b*b*vaa - 2.0*a*b*vab + a*a*vbb) / (A2 * A2)));
+        } else {
+            se_A = se_phi = std::numeric_limits<double>::infinity();
+        }
+
+        se_c = fit_offset ? std::sqrt(sigma2 * inv[2][2]) : 0.0;
+    }
+
+    return solved = true;
+}
+
+bool sin_estimator::converged(double max_amplitude_se, double max_phase_se) const {
+    if (!solved || n <= static_cast<size_t>(fit_offset ? 3 : 2)) {
+        return false;
+    }
+
+    return se_A <= max_amplitude_se && se_phi <= max_phase_se;
+}
+
 int sin_fitter::eval(int m, int n, const double *p, double *fvec) const {
 
     size_t freq_idx = fit_offset ? 3 : 2;
@@ -65,6 +499,34 @@ int sin_fitter::eval(int m, int n, const double *p, double *fvec) const {
     return 0;
 }
 
+int sin_fitter::jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const {
+
+    size_t freq_idx = fit_offset ? 3 : 2;
+
+    double A = p[0];
+    double phi = p[1];
+    double f = fit_frequency ? p[freq_idx] : 1.0;
+
+    for(int i = 0; i < static_cast<int>(x.size()); i++) {
+        const double arg = f * x[i] - phi;
+        const double c = cos(arg);
+        const double s = sin(arg);
+
+        fjac[i] = -c;
+        fjac[i + ldfjac] = -A * s;
+
+        if (fit_offset) {
+            fjac[i + 2*ldfjac] = -1.0;
+        }
+
+        if (fit_frequency) {
+            fjac[i + freq_idx*ldfjac] = A * s * x[i];
+        }
+    }
+
+    return 0;
+}
+
 
 int rgb2sml_fitter::eval(int m, int n, const double *p, double *fvec) const {
 
@@ -74,12 +536,56 @@ int rgb2sml_fitter::eval(int m, int n, const double *p, double *fvec) const {
     const double *A = p + 3;
     const double *g = p + 3 + 3*3;
 
+    // samples are blocked by cone, then channel; each block of N
+    // intensities shares the exponent g[channel]
+    for (int cone = 0; cone < 3; cone++) {
+        for (int channel = 0; channel < 3; channel++) {
+            const int offset = 3*N*cone + N*channel;
+            const double a0 = A0[cone];
+            const double a = A[3 * cone + channel];
+
+            vmath::exp_ax(logx.data() + offset, g[channel], xg.data() + offset, N);
+
+            for (int i = offset; i < offset + N; i++) {
+                double deviate = y[i] - (a0 + a * xg[i]);
+                fvec[i] = deviate * weight[i];
+            }
+        }
+    }
+
+    return 0;
+}
+
+int rgb2sml_fitter::jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const {
+
+    const int N = m / (3*3);
+
+    const double *A = p + 3;
+    const double *g = p + 3 + 3*3;
+
+    // each residual only depends on A0[cone], A[cone, channel] and g[channel]
+    for (int k = 0; k < n; k++) {
+        std::fill_n(fjac + k*ldfjac, m, 0.0);
+    }
+
     for (int cone = 0; cone < 3; cone++) {
         for (int channel = 0; channel < 3; channel++) {
-            for (int intensity = 0; intensity < N; intensity++) {
-                int i = 3*N*cone + N*channel + intensity;
-                double deviate = y[i] - (A0[cone] + A[3 * cone + channel] * std::pow(x[i], g[channel]));
-                fvec[i] = deviate * 1.0/std::pow(y[i], we);
+            const int offset = 3*N*cone + N*channel;
+            const double a = A[3*cone + channel];
+
+            double *dA0 = fjac + cone*ldfjac;
+            double *dA = fjac + (3 + 3*cone + channel)*ldfjac;
+            double *dg = fjac + (12 + channel)*ldfjac;
+
+            vmath::exp_ax(logx.data() + offset, g[channel], xg.data() + offset, N);
+
+            for (int i = offset; i < offset + N; i++) {
+                const double w = weight[i];
+                const double lx = x[i] > 0.0 ? logx[i] : 0.0;
+
+                dA0[i] = -w;
+                dA[i] = -w * xg[i];
+                dg[i] = -w * a * xg[i] * lx;
             }
         }
     }
@@ -2,11 +2,20 @@
 #define IRIS_FIT_H
 
 #include <dkl.h>
+#include <vmath.h>
 
 #include <vector>
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <random>
+
+// bump when a change to the fitters alters their results; it is part
+// of the keys of fit results cached in the store
+#define IRIS_FIT_VERSION 1
 
 namespace iris {
 
@@ -25,19 +34,51 @@ struct fitter {
         return 1.49012e-8;
     }
 
+    // analytic jacobian, column-major: fjac[i + j*ldfjac] = d fvec[i] / d p[j]
+    // if implemented, has_jacobian() must return true and the fit will use
+    // lmder instead of the finite difference approximation of lmdif
+    virtual bool has_jacobian() const {
+        return false;
+    }
+
+    virtual int jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const {
+        return -1;
+    }
+
+    void use_jacobian(bool use) {
+        with_jacobian = use;
+    }
+
+    // statistics of the last fit
+    int info() const { return fit_info; }
+    int evaluations() const { return n_eval; }
+    int jacobian_evaluations() const { return n_jac; }
+    double residual() const { return fit_residual; } // sum of squares
+
+    virtual ~fitter() { }
+
 protected:
-    int fit_info;
+    int fit_info = 0;
+    double fit_residual = 0.0;
+    int n_eval = 0;
+    int n_jac = 0;
+    bool with_jacobian = true;
+
+private:
+    friend struct fitter_callback;
 };
 
 
 class gamma_fitter : public fitter {
 public:
 
-    gamma_fitter(const std::vector<double> x, const std::vector<double> y) : x(x), y(y) {
+    gamma_fitter(const std::vector<double> x, const std::vector<double> y)
+            : x(x), y(y), logx(x.size()), xg(x.size()) {
         res[0] = y[0];
         res[1] = 0.0003;
         res[2] = 2.2;
 
+        vmath::log(this->x.data(), logx.data(), logx.size());
     }
 
     static double func(const double Azero, const double A, const double gamma, const double x) {
@@ -45,6 +86,11 @@ public:
     }
 
     virtual int eval(int m, int n, const double *p, double *fvec) const override;
+    virtual int jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const override;
+
+    virtual bool has_jacobian() const override {
+        return true;
+    }
 
     double Azero() const {
         return res[0];
@@ -74,6 +120,8 @@ public:
 private:
     std::vector<double> x;
     std::vector<double> y;
+    std::vector<double> logx;        // x^g is evaluated as exp(g * log(x))
+    mutable std::vector<double> xg;  // scratch for x^g
     double res[3];
 };
 
@@ -106,7 +154,19 @@ public:
         p[freq_idx] = 1; // frequency
     }
 
+    // with a fixed frequency the model is linear in (a cos x + b sin x + offset)
+    // and solved directly; otherwise that solution is the start for LM
+    virtual bool operator()() override;
+
+    // closed-form least-squares solution for frequency 1
+    bool linear_fit();
+
     virtual int eval(int m, int n, const double *p, double *fvec) const override;
+    virtual int jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const override;
+
+    virtual bool has_jacobian() const override {
+        return true;
+    }
 
     virtual int num_parameter() const override {
         int params = 4;
@@ -137,10 +197,55 @@ public:
     size_t freq_idx;
 };
 
+// Incremental least-squares estimate of offset + A cos(x - phi), for data
+// that arrives one sample at a time (e.g. during an experiment). Each add()
+// folds the sample into the normal equations and re-solves them, so an
+// update costs the same regardless of how many samples came before. The
+// standard errors come from sigma^2 (X^T X)^-1, propagated to amplitude
+// and phase to first order; they are infinite until there are more
+// samples than parameters.
+class sin_estimator {
+public:
+    // offset < 0 means the offset is estimated, otherwise it is fixed
+    explicit sin_estimator(double offset = -1);
+
+    // returns whether there is a solution after adding (x, y)
+    bool add(double x, double y);
+    void reset();
+
+    // true once both standard errors are at or below the given limits
+    bool converged(double max_amplitude_se, double max_phase_se) const;
+
+    size_t samples() const { return n; }
+    bool valid() const { return solved; }
+
+    double amplitude() const { return A; }
+    double phase() const { return phi; }
+    double offset() const { return c; }
+
+    double amplitude_se() const { return se_A; }
+    double phase_se() const { return se_phi; }
+    double offset_se() const { return se_c; }
+    double sigma() const { return std::sqrt(sigma2); } // residual std. dev.
+
+private:
+    bool   fit_offset;
+    double dc;
+
+    size_t n;
+    double xtx[3][3];
+    double xty[3];
+    double yty;
+
+    bool   solved;
+    double A, phi, c;
+    double sigma2, se_A, se_phi, se_c;
+};
+
 class rgb2sml_fitter : public fitter {
 public:
     rgb2sml_fitter(const std::vector<double> &x, const std::vector<double> &y, const double weight_exponent = 1.1)
-            : x(x), y(y), we(weight_exponent) {
+            : x(x), y(y), we(weight_exponent), logx(x.size()), weight(y.size()), xg(x.size()) {
         res[0] = res[1] = res[2] = 0.01;
 
         res[3] = res[6] = res[9] = 0.00005;
@@ -148,9 +253,19 @@ public:
         res[5] = res[8] = res[11] = 0.00001;
 
         res[12] = res[13] = res[14] = 0.9;
+
+        vmath::log(x.data(), logx.data(), logx.size());
+        std::transform(y.cbegin(), y.cend(), weight.begin(), [weight_exponent](double v) {
+            return 1.0/std::pow(v, weight_exponent);
+        });
     }
 
     virtual int eval(int m, int n, const double *p, double *fvec) const override;
+    virtual int jacobian(int m, int n, const double *p, double *fjac, int ldfjac) const override;
+
+    virtual bool has_jacobian() const override {
+        return true;
+    }
 
     virtual int num_parameter() const override {
         return 15; // 3 * Ao (AoS, AoM, AoL), 3 * gamma (R, G, B), 3x3 A, Matrix(ArS, AgS..)
@@ -174,8 +289,139 @@ public:
     const std::vector<double> &y;
     const double we;
     double res[15];
+
+private:
+    std::vector<double> logx;        // x^g is evaluated as exp(g * log(x))
+    std::vector<double> weight;      // 1/y^we
+    mutable std::vector<double> xg;  // scratch for x^g
+};
+
+
+// multi-start fitting
+
+struct multistart_result {
+    std::vector<double> params;    // best parameters found
+    double              residual;  // residual of the best fit
+    size_t              converged; // number of successful fits
+    std::vector<double> residuals; // per start, NaN if failed
+};
+
+class multistart {
+public:
+    typedef std::function<std::unique_ptr<fitter>()> factory;
+
+    multistart(factory make) : make(make) { }
+
+    // Fits from each of the starts concurrently, keeping the best residual.
+    multistart_result operator()(const std::vector<std::vector<double>> &starts,
+                                 size_t nthreads = 0) const;
+
+    // n starts uniformly distributed via latin hypercube sampling
+    template<typename URNG>
+    static std::vector<std::vector<double>> latin_hypercube(const std::vector<double> &lower,
+                                                            const std::vector<double> &upper,
+                                                            size_t n,
+                                                            URNG &&g);
+
+    // n starts scattered multiplicatively (log-normal, sigma = spread) around
+    // the given start; the first start is the unperturbed one
+    template<typename URNG>
+    static std::vector<std::vector<double>> perturbed(const std::vector<double> &start,
+                                                      double spread,
+                                                      size_t n,
+                                                      URNG &&g);
+
+private:
+    factory make;
+};
+
+
+// bootstrap and jackknife resampling of fits
+
+struct resample_result {
+    size_t replicates; // number of refits attempted
+    size_t failed;     // number of refits that did not converge
+    std::vector<std::vector<double>> params; // per successful refit
+
+    std::vector<double> column(size_t k) const;
+};
+
+class resampler {
+public:
+    typedef std::function<std::unique_ptr<fitter>(const std::vector<double> &x,
+                                                  const std::vector<double> &y)> factory;
+
+    resampler(factory make, const std::vector<double> &x, const std::vector<double> &y)
+            : make(make), x(x), y(y) { }
+
+    // n fits on samples drawn with replacement; replicate i is seeded
+    // from (seed, i) so results do not depend on the number of threads
+    resample_result bootstrap(size_t n, unsigned int seed = 0, size_t nthreads = 0) const;
+
+    // leave-one-out fits, one per sample
+    resample_result jackknife(size_t nthreads = 0) const;
+
+    // percentile interval covering the given level, e.g. 0.95; the
+    // level must be in (0, 1)
+    static std::pair<double, double> percentile(std::vector<double> values, double level);
+
+    // standard error estimate from jackknife replicates
+    static double jackknife_se(const std::vector<double> &values);
+
+private:
+    template<typename F>
+    resample_result refit(size_t n, size_t nthreads, F select) const;
+
+private:
+    factory make;
+    const std::vector<double> &x;
+    const std::vector<double> &y;
 };
 
+template<typename URNG>
+std::vector<std::vector<double>> multistart::latin_hypercube(const std::vector<double> &lower,
+                                                             const std::vector<double> &upper,
+                                                             size_t n,
+                                                             URNG &&g) {
+    if (lower.size() != upper.size()) {
+        throw std::invalid_argument("lower and upper bounds differ in size");
+    }
+
+    const size_t dims = lower.size();
+    std::vector<std::vector<double>> starts(n, std::vector<double>(dims));
+    std::uniform_real_distribution<double> jitter(0.0, 1.0);
+
+    std::vector<size_t> strata(n);
+    for (size_t d = 0; d < dims; d++) {
+        std::iota(strata.begin(), strata.end(), 0);
+        std::shuffle(strata.begin(), strata.end(), g);
+
+        const double width = (upper[d] - lower[d]) / n;
+        for (size_t i = 0; i < n; i++) {
+            starts[i][d] = lower[d] + (strata[i] + jitter(g)) * width;
+        }
+    }
+
+    return starts;
+}
+
+template<typename URNG>
+std::vector<std::vector<double>> multistart::perturbed(const std::vector<double> &start,
+                                                       double spread,
+                                                       size_t n,
+                                                       URNG &&g) {
+    std::vector<std::vector<double>> starts(n, start);
+    std::normal_distribution<double> noise(0.0, spread);
+
+    for (size_t i = 1; i < n; i++) {
+        for (double &v : starts[i]) {
+            v *= std::exp(noise(g));
+        }
+    }
+
+    return starts;
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -2,39 +2,298 @@
 #include <fs.h>
 
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <fnmatch.h>
 #include <libgen.h>
 #include <pwd.h>
+#include <cerrno>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
 #include <vector>
 #include <fstream>
 
 namespace fs {
 
+/// mapped_file
+
+mapped_file::mapped_file(const std::string &path) : ptr(""), len(0), mapped(false) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file for reading");
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat file");
+    }
+
+    const size_t size = static_cast<size_t>(st.st_size);
+
+    if (size >= map_threshold) {
+        void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+
+        if (addr == MAP_FAILED) {
+            throw std::runtime_error("Could not map file");
+        }
+
+        madvise(addr, size, MADV_SEQUENTIAL);
+
+        ptr = static_cast<const char *>(addr);
+        len = size;
+        mapped = true;
+        return;
+    }
+
+    buffer.reset(new char[size + 1]);
+
+    // the file might have changed since fstat, read until EOF
+    size_t have = 0;
+    while (have < size) {
+        ssize_t n = read(fd, buffer.get() + have, size - have);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            close(fd);
+            throw std::runtime_error("Error while reading data from file");
+        } else if (n == 0) {
+            break;
+        }
+        have += static_cast<size_t>(n);
+    }
+
+    close(fd);
+
+    ptr = buffer.get();
+    len = have;
+}
+
+mapped_file::~mapped_file() {
+    release();
+}
+
+mapped_file::mapped_file(mapped_file &&other)
+        : ptr(other.ptr), len(other.len), mapped(other.mapped), buffer(std::move(other.buffer)) {
+    other.ptr = "";
+    other.len = 0;
+    other.mapped = false;
+}
+
+mapped_file &mapped_file::operator=(mapped_file &&other) {
+    if (this != &other) {
+        release();
+
+        ptr = other.ptr;
+        len = other.len;
+        mapped = other.mapped;
+        buffer = std::move(other.buffer);
+
+        other.ptr = "";
+        other.len = 0;
+        other.mapped = false;
+    }
+
+    return *this;
+}
+
+void mapped_file::release() {
+    if (mapped) {
+        munmap(const_cast<char *>(ptr), len);
+    }
+
+    ptr = "";
+    len = 0;
+    mapped = false;
+    buffer.reset();
+}
+
+mapped_istream::mapped_istream(const mapped_file &view)
+        : std::istream(nullptr), buf(view.begin(), view.end()) {
+    rdbuf(&buf);
+}
+
+/// dir_iterator
+
+struct dir_iterator::state {
+    explicit state(int fd) : fd(fd), pos(0), len(0) { }
+    ~state() {
+#ifndef __linux__
+        if (dirp) {
+            closedir(dirp);
+        }
+#endif
+        close(fd);
+    }
+
+    int    fd;
+    size_t pos;
+    size_t len;
+
+    std::string pattern;
+    file_type   only;
+    std::string basepath;
+
+#ifdef __linux__
+    alignas(8) char buffer[32 * 1024];
+#else
+    DIR *dirp = nullptr;
+#endif
+};
+
+#ifdef __linux__
+// the kernel's record, glibc only exposes it via readdir
+struct linux_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1]; // NUL terminated, up to d_reclen
+};
+#endif
+
 dir_iterator::dir_iterator(const file &fd) : dir_iterator(fd.path()) {
 }
 
-dir_iterator::dir_iterator(const std::string &path) :basepath(path), dirp(nullptr), entry(nullptr) {
-    DIR *dfd = opendir(basepath.c_str());
-    if (dfd) {
-        dirp = std::shared_ptr<DIR>(dfd, closedir);
-        next();
+dir_iterator::dir_iterator(const std::string &path, const std::string &pattern, file_type only)
+        : st(nullptr), entry(nullptr), dtype(0) {
+    int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+
+    st = std::make_shared<state>(fd);
+    st->pattern = pattern;
+    st->only = only;
+    st->basepath = path;
+
+#ifndef __linux__
+    st->dirp = fdopendir(dup(fd));
+    if (st->dirp == nullptr) {
+        st.reset();
+        return;
     }
+#endif
+
+    next();
 }
 
 file dir_iterator::operator*() const {
-    return file(basepath).child(entry->d_name);
+    return file(st->basepath).child(entry);
+}
+
+file_type dir_iterator::type() const {
+    unsigned char t = dtype;
+
+    if (t == DT_UNKNOWN || t == DT_LNK) {
+        struct stat buf;
+        if (fstatat(st->fd, entry, &buf, 0) != 0) {
+            return file_type::other; // e.g. a dangling link
+        }
+        t = S_ISDIR(buf.st_mode) ? DT_DIR : (S_ISREG(buf.st_mode) ? DT_REG : DT_UNKNOWN);
+    }
+
+    switch (t) {
+    case DT_DIR: return file_type::directory;
+    case DT_REG: return file_type::regular;
+    default:     return file_type::other;
+    }
+}
+
+bool dir_iterator::is_link() const {
+    if (dtype != DT_UNKNOWN) {
+        return dtype == DT_LNK;
+    }
+
+    struct stat buf;
+    return fstatat(st->fd, entry, &buf, AT_SYMLINK_NOFOLLOW) == 0 && S_ISLNK(buf.st_mode);
+}
+
+// the next raw entry into entry and dtype, false at the end
+bool dir_iterator::read_entry() {
+#ifdef __linux__
+    if (st->pos >= st->len) {
+        long n = syscall(SYS_getdents64, st->fd, st->buffer, sizeof(st->buffer));
+        if (n <= 0) {
+            return false;
+        }
+
+        st->pos = 0;
+        st->len = static_cast<size_t>(n);
+    }
+
+    const linux_dirent64 *d = reinterpret_cast<const linux_dirent64 *>(st->buffer + st->pos);
+    st->pos += d->d_reclen;
+
+    entry = d->d_name;
+    dtype = d->d_type;
+#else
+    struct dirent *d = readdir(st->dirp);
+    if (d == nullptr) {
+        return false;
+    }
+
+    entry = d->d_name;
+    dtype = DT_UNKNOWN;
+#ifdef _DIRENT_HAVE_D_TYPE
+    dtype = d->d_type;
+#endif
+#endif
+
+    return true;
 }
 
 void dir_iterator::next() {
+    while (read_entry()) {
+        if (entry[0] == '.' && (entry[1] == '\0' || (entry[1] == '.' && entry[2] == '\0'))) {
+            continue;
+        }
 
-    bool show_hidden = true;
+        if (!st->pattern.empty() && fnmatch(st->pattern.c_str(), entry, FNM_PERIOD) != 0) {
+            continue;
+        }
 
-    do {
-        readdir_r(dirp.get(), &buffer, &entry);
-    } while(entry != nullptr && (!show_hidden && entry->d_name[0] == '.'));
+        if (st->only != file_type::any && type() != st->only) {
+            continue;
+        }
+
+        return;
+    }
+
+    entry = nullptr;
+    st.reset();
+}
+
+static mode_t read_umask() {
+    // Linux >= 4.7 reports it without changing it
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 6, "Umask:") == 0) {
+            return static_cast<mode_t>(std::strtoul(line.c_str() + 6, nullptr, 8));
+        }
+    }
+
+    // otherwise it can only be read by setting it, which is a race with
+    // threads creating files; hence done once, during static initialization
+    mode_t m = umask(0);
+    umask(m);
+    return m;
 }
 
+static const mode_t initial_umask = read_umask();
+
+static mode_t process_umask() {
+    return initial_umask;
+}
 
 /// file
 
@@ -130,6 +389,17 @@ bool file::is_directory() const {
     return res == 0 && S_ISDIR(buf.st_mode);
 }
 
+int64_t file::mtime() const {
+    struct stat buf;
+    int res = stat(loc.c_str(), &buf);
+
+    if (res != 0) {
+        return -1;
+    }
+
+    return static_cast<int64_t>(buf.st_mtim.tv_sec) * 1000000000 + buf.st_mtim.tv_nsec;
+}
+
 file file::readlink() const {
 
     std::vector<char> buffer(1024, 0);
@@ -166,79 +436,248 @@ file file::readlink() const {
 //}
 
 std::string file::read_all() const {
-    std::ifstream fd(loc, std::ios::in | std::ios::ate);
+    std::ifstream fd(loc, std::ios::in | std::ios::binary | std::ios::ate);
 
     if (!fd.is_open()) {
         throw std::runtime_error("Could not open file for reading");
     }
 
-    std::streampos size = fd.tellg();
-    std::vector<char> data(static_cast<size_t>(size));
+    // read straight into the string, no intermediate buffer
+    std::string data(static_cast<size_t>(fd.tellg()), '\0');
     fd.seekg(0, std::ios::beg);
-    fd.read(data.data(), data.size());
+    fd.read(&data[0], data.size());
 
     if (!fd.good()) {
         throw std::runtime_error("Error while reading data from file");
     }
 
-    return std::string(data.data(), data.size());
+    return data;
 }
 
+mapped_file file::map() const {
+    return mapped_file(loc);
+}
 
-void file::write_all(const std::string &data) {
 
-    bool file_exists = exists();
-    // todo: do atomic replace
-    //       make temp with mkstemp, write, rename
-    std::string filepath = loc;
+// temporary file next to target, for the atomic replacements below;
+// the name starts with a dot so store scans and watchers skip it
+static int make_temp(const file &target, std::string &tmppath) {
+    char buffer[1024] = {0, };
+    fs::file parent_dir = target.parent();
+    snprintf(buffer, sizeof(buffer), "%s/.%sXXXXXX", parent_dir.path().c_str(), target.name().c_str());
 
-    if (file_exists) {
-        char buffer[1024] = {0, };
-        fs::file parent_dir = parent();
-        snprintf(buffer, sizeof(buffer), "%s/.%sXXXXXX", parent_dir.path().c_str(), name().c_str());
-        filepath = mktemp(buffer);
+    int fd = mkostemp(buffer, O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Could not create temporary file");
     }
 
-    std::ofstream fd(filepath, std::ios::binary | std::ios::trunc);
-    fd.write(data.c_str(), data.size());
-    fd.close();
+    // mkstemp creates the file with 0600
+    fchmod(fd, 0666 & ~process_umask());
 
-    if (!fd.good()) {
-        // hmm, clear out temporary file
-        throw std::runtime_error("Error wile writing data to file");
+    tmppath = buffer;
+    return fd;
+}
+
+// rename tmppath over target, with durable also flush the file data
+// before and the directory entry after
+static void commit_temp(int fd, const std::string &tmppath, const file &target, bool durable) {
+    if (durable && fsync(fd) != 0) {
+        close(fd);
+        unlink(tmppath.c_str());
+        throw std::runtime_error("Atomic IO failed (fsync)");
+    }
+
+    if (close(fd) != 0) {
+        unlink(tmppath.c_str());
+        throw std::runtime_error("Atomic IO failed (close)");
+    }
+
+    int res = rename(tmppath.c_str(), target.path().c_str());
+    if (res != 0) {
+        unlink(tmppath.c_str()); //ignore errors, can't do much
+        throw std::runtime_error("Atomic IO failed (rename)");
+    }
+
+    if (durable) {
+        int dfd = open(target.parent().path().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dfd >= 0) {
+            fsync(dfd); // best effort, not all filesystems support it
+            close(dfd);
+        }
     }
+}
 
-    if (file_exists) {
-        int res = rename(filepath.c_str(), path().c_str());
-        if (res != 0) {
-            unlink(filepath.c_str()); //ignore errors, can't do much
-            throw std::runtime_error("Atomic IO failed (rename)");
+static void write_atomically(const file &target, const std::string &data, bool durable) {
+    std::string tmppath;
+    int fd = make_temp(target, tmppath);
+
+    const char *ptr = data.data();
+    size_t left = data.size();
+
+    while (left > 0) {
+        ssize_t n = write(fd, ptr, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            close(fd);
+            unlink(tmppath.c_str());
+            throw std::runtime_error("Error wile writing data to file");
         }
+
+        ptr += n;
+        left -= static_cast<size_t>(n);
+    }
+
+    commit_temp(fd, tmppath, target, durable);
+}
+
+void file::write_all(const std::string &data) {
+    // atomic replace: write to a temporary file and rename it over
+    // the destination, so readers never see partial data
+    write_atomically(*this, data, false);
+}
+
+void file::atomic_write(const std::string &data) {
+    write_atomically(*this, data, true);
+}
+
+void file::durable_rename(const file &target) const {
+    int fd = open(loc.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        unlink(loc.c_str());
+        throw std::runtime_error("Could not open file for syncing");
     }
 
+    commit_temp(fd, loc, target, true);
 }
 
 
+bool file::remove() const {
+    int res = unlink(loc.c_str());
+
+    if (res != 0 && errno != ENOENT) {
+        throw std::runtime_error("Could not remove file");
+    }
+
+    return res == 0;
+}
+
+// copy all of in to out within the kernel; false if that is not
+// possible for these files and nothing was copied
+static bool kernel_copy(int in, int out, size_t size) {
+    if (size == 0) {
+        return false; // empty, or a procfs/sysfs file that only says so
+    }
+
+#ifdef FICLONE
+    if (ioctl(out, FICLONE, in) == 0) {
+        return true; // reflink, shares the extents (btrfs, xfs, ...)
+    }
+#endif
+
+#ifdef __linux__
+    size_t left = size;
+    bool use_cfr = true;
+
+    while (left > 0) {
+        ssize_t n;
+
+        if (use_cfr) {
+            n = copy_file_range(in, nullptr, out, nullptr, left, 0);
+            if ((n < 0 && left == size && (errno == ENOSYS || errno == EXDEV ||
+                                           errno == EINVAL || errno == EOPNOTSUPP)) ||
+                (n == 0 && left == size)) {
+                // e.g. across filesystems on older kernels; some
+                // filesystems (FUSE, NFS, ...) copy nothing instead
+                use_cfr = false;
+                continue;
+            }
+        } else {
+            n = sendfile(out, in, nullptr, left);
+            if ((n < 0 && left == size && (errno == ENOSYS || errno == EINVAL)) ||
+                (n == 0 && left == size)) {
+                return false;
+            }
+        }
+
+        if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0) {
+            throw std::runtime_error("copy error: IO error");
+        } else if (n == 0) {
+            break;
+        }
+
+        left -= static_cast<size_t>(n);
+    }
+
+    if (left != 0) {
+        throw std::runtime_error("copy error: source got shorter");
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 void file::copy(fs::file &dest, bool overwrite) const {
 
     if (dest.exists() && !overwrite) {
         throw std::runtime_error("destination exists");
     }
 
-    std::fstream input(path(), std::ios::in | std::ios::binary);
-    std::fstream output(dest.path(), std::ios::out | std::ios::binary);
+    int in = open(path().c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        throw std::runtime_error("copy error: could not open source");
+    }
 
-    char buffer[4096];
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        close(in);
+        throw std::runtime_error("copy error: could not stat source");
+    }
 
-    while (output.good() && input.good()) {
-        input.read(buffer, sizeof(buffer));
-        std::streamsize nread = input.gcount();
-        output.write(buffer, nread);
+    // copy to a temporary file and rename it into place, so that
+    // a crash never leaves a truncated destination behind
+    std::string tmppath;
+    int out;
+    try {
+        out = make_temp(dest, tmppath);
+    } catch (...) {
+        close(in);
+        throw;
     }
 
-    if ((!input.good() && !input.eof()) || !output.good()) {
-        throw std::runtime_error("copy error: IO error");
+    try {
+        if (!kernel_copy(in, out, static_cast<size_t>(st.st_size))) {
+            char buffer[64 * 1024];
+            ssize_t n;
+            while ((n = read(in, buffer, sizeof(buffer))) != 0) {
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                } else if (n < 0) {
+                    throw std::runtime_error("copy error: IO error");
+                }
+
+                for (ssize_t off = 0; off < n;) {
+                    ssize_t k = write(out, buffer + off, static_cast<size_t>(n - off));
+                    if (k < 0 && errno != EINTR) {
+                        throw std::runtime_error("copy error: IO error");
+                    }
+                    off += k < 0 ? 0 : k;
+                }
+            }
+        }
+    } catch (...) {
+        close(in);
+        close(out);
+        unlink(tmppath.c_str());
+        throw;
     }
+
+    close(in);
+    commit_temp(out, tmppath, dest, true);
 }
 
 file file::current_directory() {
@@ -6,12 +6,77 @@
 #include <memory>
 #include <dirent.h>
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 
 namespace fs {
 
 class file;
 
+/* Read-only view of a whole file. Files of at least map_threshold bytes
+ * are mmap'ed, smaller ones are read with a single read(2) into a
+ * buffer, which is cheaper than setting up a mapping. The data is not
+ * NUL terminated; it stays valid as long as the object lives (a file
+ * truncated by another process while mapped will fault on access).
+ */
+class mapped_file {
+public:
+    static const size_t map_threshold = 64 * 1024;
+
+    mapped_file() : ptr(""), len(0), mapped(false) { }
+    explicit mapped_file(const std::string &path);
+    ~mapped_file();
+
+    mapped_file(mapped_file &&other);
+    mapped_file &operator=(mapped_file &&other);
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const char *data() const { return ptr; }
+    size_t size() const { return len; }
+    bool empty() const { return len == 0; }
+
+    const char *begin() const { return ptr; }
+    const char *end() const { return ptr + len; }
+
+    std::string str() const { return std::string(ptr, len); }
+
+private:
+    void release();
+
+private:
+    const char *ptr;
+    size_t      len;
+    bool        mapped;
+    std::unique_ptr<char[]> buffer;
+};
+
+// std::istream over a mapped_file without copying, e.g. for YAML::Load
+class mapped_istream : public std::istream {
+public:
+    explicit mapped_istream(const mapped_file &view);
+
+private:
+    struct view_buf : std::streambuf {
+        view_buf(const char *first, const char *last) {
+            char *p = const_cast<char *>(first);
+            setg(p, p, const_cast<char *>(last));
+        }
+    };
+
+    view_buf buf;
+};
+
+// type of a directory entry, symbolic links are followed
+enum class file_type { any, regular, directory, other };
+
+/* Enumerates a directory, reading the entries in batches (getdents64(2)
+ * on Linux) and taking their type from d_type, so that filtering by type
+ * needs no stat(2) call on most filesystems. "." and ".." are never
+ * returned; with a pattern only names matching it via fnmatch(3) are,
+ * leading dots must be matched explicitly. Copies share the position.
+ */
 class dir_iterator {
 public:
     typedef std::input_iterator_tag iterator_category;
@@ -21,8 +86,10 @@ public:
     typedef const value_type &reference;
 
     dir_iterator(const file &fd);
-    dir_iterator(const std::string &path);
-    dir_iterator() : basepath(), dirp(nullptr), entry(nullptr) { }
+    dir_iterator(const std::string &path,
+                 const std::string &pattern = "",
+                 file_type only = file_type::any);
+    dir_iterator() : st(nullptr), entry(nullptr), dtype(0) { }
 
 
     dir_iterator& operator++() {
@@ -38,11 +105,15 @@ public:
 
     file operator*() const;
 
+    const char *name() const { return entry; }
+    file_type type() const;
+    bool is_link() const;
+
     bool operator==(const dir_iterator &o) const {
         if (entry == nullptr && o.entry == nullptr) {
             return true;
         } else if(entry != nullptr && o.entry != nullptr &&
-                  !strcmp(entry->d_name, o.entry->d_name)) {
+                  !strcmp(entry, o.entry)) {
             return true;
         }
 
@@ -55,12 +126,14 @@ public:
 
 private:
     void next();
+    bool read_entry();
 
 private:
-    std::string basepath;
-    std::shared_ptr<DIR> dirp;
-    struct dirent *entry;
-    struct dirent  buffer;
+    struct state;
+    std::shared_ptr<state> st;
+
+    const char *entry;    // name, points into st's buffer
+    unsigned char dtype;  // DT_*, DT_UNKNOWN until resolved
 };
 
 class file {
@@ -89,6 +162,9 @@ public:
 
     bool is_directory() const;
 
+    // modification time in ns since the epoch, -1 if it does not exist
+    int64_t mtime() const;
+
     file readlink() const;
 
     // IO
@@ -96,12 +172,21 @@ public:
     std::fstream stream(std::ios::openmode mode = std::ios::in|std::ios::out) const;
 
     std::string read_all() const;
-    void write_all(const std::string &data);
+    mapped_file map() const;
+    void write_all(const std::string &data);      // atomic (rename)
+    void atomic_write(const std::string &data);   // atomic and durable (fsync)
+
+    // rename over target, durably: the data is synced before and the
+    // directory entry after; this file is removed if that fails
+    void durable_rename(const file &target) const;
 
 
     // fs functions
 
+    // in-kernel (reflink, copy_file_range or sendfile) where possible;
+    // dest is replaced atomically and synced to disk
     void copy(fs::file &dest, bool overwrite = false) const;
+    bool remove() const; // false if it did not exist
 
     // obtain files
 
@@ -118,15 +203,18 @@ public:
 
     struct dir_enum {
 
-        dir_enum(const std::string &path) : path(path) { }
-        dir_iterator begin() {  return dir_iterator(path);  }
+        dir_enum(const std::string &path, const std::string &pattern, file_type only)
+                : path(path), pattern(pattern), only(only) { }
+        dir_iterator begin() {  return dir_iterator(path, pattern, only);  }
         dir_iterator end() { return dir_iterator{}; }
 
         std::string path;
+        std::string pattern;
+        file_type   only;
     };
 
-    dir_enum children() const {
-        return dir_enum(loc);
+    dir_enum children(const std::string &pattern = "", file_type only = file_type::any) const {
+        return dir_enum(loc, pattern, only);
     }
 
     static file make_dir(const std::string &path);
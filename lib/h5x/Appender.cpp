@@ -0,0 +1,86 @@
+#include <h5x/Appender.hpp>
+#include <h5x/Error.hpp>
+
+#include <algorithm>
+
+namespace h5x {
+
+Appender::Appender(const Group &group, const std::string &name, TypeId dtype,
+                   const NDSize &record, size_t chunkRecords,
+                   const DataSetOptions &options)
+        : dtype(dtype), rec(record), n(0) {
+
+    NDSize shape(rec.size() + 1, 0);
+    for (size_t i = 0; i < rec.size(); i++) {
+        if (rec[i] == 0) {
+            throw std::invalid_argument("Appender: empty record dimension");
+        }
+        shape[i + 1] = rec[i];
+    }
+
+    if (group.hasData(name)) {
+        ds = group.openData(name);
+
+        NDSize have = ds.size();
+        if (have.size() != shape.size() || ds.dataType() != dtype) {
+            throw std::invalid_argument("Appender: existing DataSet " + name + " does not match");
+        }
+
+        for (size_t i = 1; i < have.size(); i++) {
+            if (have[i] != shape[i]) {
+                throw std::invalid_argument("Appender: existing DataSet " + name + " does not match");
+            }
+        }
+
+        n = static_cast<size_t>(have[0]);
+        return;
+    }
+
+    const size_t recBytes = data_type_to_size(dtype) * static_cast<size_t>(rec ? rec.nelms() : 1);
+    if (chunkRecords == 0) {
+        chunkRecords = std::max<size_t>(1, 16 * 1024 / recBytes);
+    }
+
+    DataSetOptions opts = options;
+    opts.chunks = shape;
+    opts.chunks[0] = chunkRecords;
+
+    ds = group.createData(name, data_type_to_h5_filetype(dtype), shape, opts);
+}
+
+void Appender::append(const void *data, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    NDSize extent(rec.size() + 1, 0);
+    NDSize offset(rec.size() + 1, 0);
+    NDSize block(rec.size() + 1, 0);
+
+    extent[0] = n + count;
+    offset[0] = n;
+    block[0] = count;
+
+    for (size_t i = 0; i < rec.size(); i++) {
+        extent[i + 1] = rec[i];
+        block[i + 1] = rec[i];
+    }
+
+    ds.setExtent(extent);
+
+    Selection fileSel(ds.getSpace());
+    fileSel.select(block, offset);
+    Selection memSel(DataSpace::create(block, false));
+
+    ds.write(dtype, data, fileSel, memSel);
+    n += count;
+}
+
+void Appender::flush()
+{
+    HErr res = H5Fflush(ds.h5id(), H5F_SCOPE_LOCAL);
+    res.check("Appender::flush(): could not flush file");
+}
+
+} // namespace h5x
@@ -0,0 +1,86 @@
+#ifndef H5X_APPENDER_H
+#define H5X_APPENDER_H
+
+#include <h5x/Group.hpp>
+#include <h5x/DataSet.hpp>
+
+#include <string>
+#include <vector>
+
+namespace h5x {
+
+/**
+ * Appends records of a fixed shape to a DataSet whose first dimension
+ * is unlimited, growing it via setExtent() as records come in. The
+ * DataSet is chunked along the first dimension, so appending does not
+ * rewrite existing data. An existing DataSet of the same record shape
+ * is continued.
+ */
+class Appender {
+
+public:
+
+    Appender() : dtype(TypeId::Nothing), n(0) { }
+
+    /**
+     * @param group         Group to create (or open) the DataSet in
+     * @param name          Name of the DataSet
+     * @param dtype         Element type, in memory and in the file
+     * @param record        Shape of one record, {} for scalars
+     * @param chunkRecords  Records per chunk, 0 to pick ~16 KiB chunks
+     * @param options       Filters and chunk cache of a new DataSet; its
+     *                      chunk shape is always set from chunkRecords
+     */
+    Appender(const Group &group, const std::string &name, TypeId dtype,
+             const NDSize &record = {}, size_t chunkRecords = 0,
+             const DataSetOptions &options = DataSetOptions());
+
+    /**
+     * Append count records, stored contiguously at data
+     */
+    void append(const void *data, size_t count = 1);
+
+    template<typename T> void append(const std::vector<T> &records);
+
+    /**
+     * Flush the whole file the DataSet belongs to
+     */
+    void flush();
+
+    size_t size() const { return n; }
+    const NDSize &recordShape() const { return rec; }
+    DataSet &dataSet() { return ds; }
+
+private:
+    DataSet ds;
+    TypeId  dtype;
+    NDSize  rec;
+    size_t  n;
+};
+
+
+/**
+ * Append the elements of a vector, as records if their count is a
+ * multiple of the record size; structs with element_traits count as
+ * their elements, e.g. a std::vector<iris::rgb> fills records of {3}
+ */
+template<typename T> void Appender::append(const std::vector<T> &records)
+{
+    typedef data_traits<std::vector<T>> traits;
+
+    if (to_type_id<typename traits::element_type>::value != dtype) {
+        throw std::invalid_argument("Appender::append(): type mismatch");
+    }
+
+    const size_t per = rec ? static_cast<size_t>(rec.nelms()) : 1;
+    const size_t nelms = traits::num_elements(records);
+    if (nelms % per != 0) {
+        throw std::invalid_argument("Appender::append(): partial record");
+    }
+
+    append(traits::get_data(records), nelms / per);
+}
+
+} // namespace h5x
+
+#endif // H5X_APPENDER_H
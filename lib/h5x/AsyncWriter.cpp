@@ -0,0 +1,255 @@
+#include <h5x/AsyncWriter.hpp>
+
+#include <cstdint>
+#include <stdexcept>
+
+namespace h5x {
+
+static size_t queue_size(size_t capacity)
+{
+    size_t n = 2;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    return n;
+}
+
+AsyncWriter::AsyncWriter(const File &fd, size_t capacity)
+        : fd(fd), cells(queue_size(capacity)), mask(cells.size() - 1),
+          head(0), tail(0), done(0), idle(false), waiters(0), nstalls(0),
+          has_failed(false), stopping(false) {
+
+    for (size_t i = 0; i < cells.size(); i++) {
+        cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    worker = std::thread([this]() { run(); });
+}
+
+AsyncWriter::~AsyncWriter()
+{
+    try {
+        close();
+    } catch (...) {
+
+    }
+}
+
+// Bounded MPMC queue after D. Vyukov: every cell carries a sequence
+// number telling whether it is free for the ticket at hand (seq == ticket)
+// or holds the job of that ticket (seq == ticket + 1).
+
+bool AsyncWriter::push(Job &job, size_t &ticket)
+{
+    size_t pos = head.load(std::memory_order_relaxed);
+    Cell *cell;
+
+    while (true) {
+        cell = &cells[pos & mask];
+        const size_t seq = cell->seq.load(std::memory_order_acquire);
+        const intptr_t dif = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+        if (dif == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false; // full
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->job = std::move(job);
+    cell->seq.store(pos + 1, std::memory_order_release);
+
+    ticket = pos;
+    return true;
+}
+
+// single consumer: the writer thread
+bool AsyncWriter::pop(Job &job, size_t &ticket)
+{
+    const size_t pos = tail.load(std::memory_order_relaxed);
+    Cell &cell = cells[pos & mask];
+
+    if (cell.seq.load(std::memory_order_acquire) != pos + 1) {
+        return false; // empty, or the job is still being stored
+    }
+
+    job = std::move(cell.job);
+    cell.seq.store(pos + mask + 1, std::memory_order_release);
+    tail.store(pos + 1, std::memory_order_relaxed);
+
+    ticket = pos;
+    return true;
+}
+
+size_t AsyncWriter::enqueue(Job &&job)
+{
+    rethrow();
+
+    if (stopping) {
+        throw std::logic_error("AsyncWriter: submit after close");
+    }
+
+    size_t ticket;
+    if (!push(job, ticket)) {
+        nstalls++;
+        waiters++;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        std::unique_lock<std::mutex> guard(lock);
+        while (!push(job, ticket)) {
+            cv_done.wait(guard);
+        }
+        waiters--;
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle.exchange(false)) {
+        std::lock_guard<std::mutex> guard(lock);
+        cv_work.notify_one();
+    }
+
+    return ticket;
+}
+
+void AsyncWriter::submit(Job &&job)
+{
+    enqueue(std::move(job));
+}
+
+bool AsyncWriter::trySubmit(Job &&job)
+{
+    rethrow();
+
+    if (stopping) {
+        throw std::logic_error("AsyncWriter: submit after close");
+    }
+
+    size_t ticket;
+    if (!push(job, ticket)) {
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle.exchange(false)) {
+        std::lock_guard<std::mutex> guard(lock);
+        cv_work.notify_one();
+    }
+
+    return true;
+}
+
+void AsyncWriter::wait_done(size_t ticket)
+{
+    waiters++;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        cv_done.wait(guard, [this, ticket]() { return done.load() > ticket; });
+    }
+
+    waiters--;
+}
+
+void AsyncWriter::flush()
+{
+    const size_t ticket = enqueue(Job([](File &fd) { fd.flush(); }));
+    wait_done(ticket);
+    rethrow();
+}
+
+void AsyncWriter::close()
+{
+    if (!worker.joinable()) {
+        rethrow();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    cv_work.notify_all();
+
+    worker.join();
+    rethrow();
+}
+
+size_t AsyncWriter::pending() const
+{
+    const size_t d = done.load();
+    const size_t h = head.load();
+    return h > d ? h - d : 0;
+}
+
+void AsyncWriter::rethrow() const
+{
+    if (has_failed) {
+        std::lock_guard<std::mutex> guard(lock);
+        std::rethrow_exception(error);
+    }
+}
+
+void AsyncWriter::run()
+{
+    while (true) {
+        Job job;
+        size_t ticket;
+
+        if (pop(job, ticket)) {
+            if (!has_failed) {
+                try {
+                    job(fd);
+                } catch (...) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    error = std::current_exception();
+                    has_failed = true;
+                }
+            }
+
+            job = Job(); // release what it holds while still on this thread
+
+            done.store(ticket + 1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiters.load() > 0) {
+                std::lock_guard<std::mutex> guard(lock);
+                cv_done.notify_all();
+            }
+
+            continue;
+        }
+
+        idle.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        const size_t pos = tail.load(std::memory_order_relaxed);
+        if (cells[pos & mask].seq.load(std::memory_order_acquire) == pos + 1) {
+            idle.store(false);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(lock);
+        if (stopping) {
+            break;
+        }
+
+        cv_work.wait(guard, [this]() { return !idle.load() || stopping; });
+        idle.store(false);
+    }
+
+    try {
+        fd.close();
+    } catch (...) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!error) {
+            error = std::current_exception();
+            has_failed = true;
+        }
+    }
+}
+
+} // namespace h5x
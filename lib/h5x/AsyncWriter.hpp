@@ -0,0 +1,145 @@
+#ifndef H5X_ASYNCWRITER_H
+#define H5X_ASYNCWRITER_H
+
+#include <h5x/File.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace h5x {
+
+/**
+ * Owns a File and runs write jobs on it on a dedicated thread, so that
+ * the submitting threads never wait for HDF5. Jobs are passed through a
+ * bounded lock-free queue; when it is full, submit() blocks until the
+ * writer catches up (back-pressure) and trySubmit() fails instead.
+ *
+ * HDF5 is not thread-safe: once the writer is running, the File and
+ * every object of it must only be used from within jobs, until close().
+ *
+ * The first exception thrown by a job stops the writer, the jobs still
+ * queued are dropped, and submit(), flush() and close() rethrow it.
+ */
+class AsyncWriter {
+
+public:
+
+    /**
+     * Move-only job, called with the File on the writer thread
+     */
+    class Job {
+    public:
+        Job() { }
+
+        template<typename F, typename = typename std::enable_if<
+                !std::is_same<typename std::decay<F>::type, Job>::value>::type>
+        Job(F &&f) : impl(new Impl<typename std::decay<F>::type>(std::forward<F>(f))) { }
+
+        Job(Job &&other) = default;
+        Job &operator=(Job &&other) = default;
+
+        void operator()(File &fd) { impl->run(fd); }
+        explicit operator bool() const { return impl != nullptr; }
+
+    private:
+        struct Base {
+            virtual ~Base() { }
+            virtual void run(File &fd) = 0;
+        };
+
+        template<typename F> struct Impl : Base {
+            template<typename G> explicit Impl(G &&g) : f(std::forward<G>(g)) { }
+            void run(File &fd) override { f(fd); }
+            F f;
+        };
+
+        std::unique_ptr<Base> impl;
+    };
+
+    /**
+     * @param fd        File to write to, handed over to the writer
+     * @param capacity  Jobs the queue holds, rounded up to a power of 2
+     */
+    explicit AsyncWriter(const File &fd, size_t capacity = 256);
+
+    AsyncWriter(const AsyncWriter &other) = delete;
+    AsyncWriter &operator=(const AsyncWriter &other) = delete;
+
+    /**
+     * Drains the queue and closes the file; errors are dropped, call
+     * close() to see them
+     */
+    ~AsyncWriter();
+
+    /**
+     * Queue a job, waiting for room if the queue is full
+     */
+    void submit(Job &&job);
+
+    /**
+     * Queue a job unless the queue is full; job is left untouched
+     * if it could not be queued
+     */
+    bool trySubmit(Job &&job);
+
+    /**
+     * Wait until all jobs submitted so far are done and flush the file
+     */
+    void flush();
+
+    /**
+     * Finish the queued jobs, close the file and stop the thread
+     */
+    void close();
+
+    size_t pending() const;              // queued or running, approximately
+    size_t stalls() const { return nstalls; }  // submit() calls that had to wait
+    bool failed() const { return has_failed; }
+
+private:
+
+    struct Cell {
+        std::atomic<size_t> seq;
+        Job job;
+    };
+
+    bool push(Job &job, size_t &ticket);
+    bool pop(Job &job, size_t &ticket);
+
+    size_t enqueue(Job &&job);
+    void wait_done(size_t ticket);
+    void rethrow() const;
+    void run();
+
+    File fd;
+
+    std::vector<Cell> cells;
+    const size_t mask;
+
+    alignas(64) std::atomic<size_t> head; // next ticket to hand out
+    alignas(64) std::atomic<size_t> tail; // next ticket to run
+    alignas(64) std::atomic<size_t> done; // tickets below are finished
+
+    std::atomic<bool> idle;               // writer is (about to go) asleep
+    std::atomic<size_t> waiters;          // threads in wait_done or submit
+    std::atomic<size_t> nstalls;
+    std::atomic<bool> has_failed;
+    std::atomic<bool> stopping;
+
+    mutable std::mutex lock;              // only for sleeping and waking
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    std::exception_ptr error;
+
+    std::thread worker;
+};
+
+} // namespace h5x
+
+#endif // H5X_ASYNCWRITER_H
@@ -103,6 +103,64 @@ void DataSet::write(TypeId         dtype,
     res.check("DataSet::write(): IO error");
 }
 
+// the memory space for count packed rows of this DataSet
+static Selection row_buffer(const NDSize &extent, ndsize_t count)
+{
+    NDSize shape = extent;
+    shape[0] = count;
+    return Selection(DataSpace::create(shape, false));
+}
+
+/**
+ * Write count consecutive rows (along the first dimension), starting at
+ * first, from packed memory with a single hyperslab
+ */
+void DataSet::writeRows(TypeId dtype, ndsize_t first, ndsize_t count, const void *data)
+{
+    NDSize extent = size();
+    if (extent.size() == 0 || first + count > extent[0]) {
+        throw std::out_of_range("DataSet::writeRows(): rows out of range");
+    }
+
+    NDSize start(extent.size(), 0);
+    NDSize block = extent;
+    start[0] = first;
+    block[0] = count;
+
+    Selection fileSel(getSpace());
+    fileSel.select(block, start);
+
+    write(dtype, data, fileSel, row_buffer(extent, count));
+}
+
+/**
+ * Write arbitrary rows from packed memory (in the order of rows, which
+ * must be ascending) with one multi-block selection and a single write
+ */
+void DataSet::writeRows(TypeId dtype, const std::vector<ndsize_t> &rows, const void *data)
+{
+    if (rows.empty()) {
+        return;
+    }
+
+    Selection fileSel(getSpace());
+    fileSel.selectRows(rows);
+
+    write(dtype, data, fileSel, row_buffer(size(), rows.size()));
+}
+
+void DataSet::readRows(TypeId dtype, const std::vector<ndsize_t> &rows, void *data) const
+{
+    if (rows.empty()) {
+        return;
+    }
+
+    Selection fileSel(getSpace());
+    fileSel.selectRows(rows);
+
+    read(dtype, data, fileSel, row_buffer(size(), rows.size()));
+}
+
 #define CHUNK_BASE   16*1024
 #define CHUNK_MIN     8*1024
 #define CHUNK_MAX  1024*1024
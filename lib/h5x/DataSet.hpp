@@ -38,6 +38,10 @@ public:
     void read(TypeId dtype, void *data, const Selection &fileSel, const Selection &memSel) const;
     void write(TypeId dtype, const void *data, const Selection &fileSel, const Selection &memSel);
 
+    void writeRows(TypeId dtype, ndsize_t first, ndsize_t count, const void *data);
+    void writeRows(TypeId dtype, const std::vector<ndsize_t> &rows, const void *data);
+    void readRows(TypeId dtype, const std::vector<ndsize_t> &rows, void *data) const;
+
     template<typename T> void read(T &value, bool resize = false) const;
     template<typename T> void read(T &value, const Selection &fileSel, bool resize = false) const;
     template<typename T> void read(T &value, const Selection &fileSel, const Selection &memSel) const;
@@ -78,7 +82,7 @@ template<typename T> void DataSet::read(T &value, bool resize) const
         hydra.resize(dims);
     }
 
-    DataType dtype = hydra.element_data_type();
+    TypeId dtype = hydra.element_data_type();
     NDSize size = hydra.shape();
     read(dtype, size, hydra.data());
 }
@@ -116,7 +120,7 @@ template<typename T> void DataSet::read(T &value, const Selection &fileSel, cons
 {
     Hydra<T> hydra(value);
 
-    DataType dtype = hydra.element_data_type();
+    TypeId dtype = hydra.element_data_type();
     this->read(dtype, hydra.data(), fileSel, memSel);
 }
 
@@ -132,7 +136,7 @@ template<typename T> void DataSet::write(const T &value)
 {
     const Hydra<const T> hydra(value);
 
-    DataType dtype = hydra.element_data_type();
+    TypeId dtype = hydra.element_data_type();
     NDSize size = hydra.shape();
     write(dtype, size, hydra.data());
 }
@@ -160,7 +164,7 @@ template<typename T> void DataSet::write(const T &value, const Selection &fileSe
 template<typename T> void DataSet::write(const T &value, const Selection &fileSel, const Selection &memSel)
 {
     const Hydra<const T> hydra(value);
-    DataType dtype = hydra.element_data_type();
+    TypeId dtype = hydra.element_data_type();
 
     this->write(dtype, hydra.data(), fileSel, memSel);
 }
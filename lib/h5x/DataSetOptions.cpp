@@ -0,0 +1,236 @@
+#include <h5x/DataSetOptions.hpp>
+#include <h5x/DataSet.hpp>
+#include <h5x/Error.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace h5x {
+
+bool DataSetOptions::hasFilter(Filter f) const
+{
+    return std::find(filters.begin(), filters.end(), f) != filters.end();
+}
+
+DataSetOptions DataSetOptions::compressed(unsigned level)
+{
+    DataSetOptions opts;
+    opts.filters = {Filter::Shuffle, Filter::Deflate};
+    opts.deflateLevel = level;
+    return opts;
+}
+
+static int parse_filter_arg(const std::string &name, const std::string &arg, int lo, int hi)
+{
+    char *end = nullptr;
+    long val = std::strtol(arg.c_str(), &end, 10);
+
+    if (arg.empty() || *end != '\0' || val < lo || val > hi) {
+        throw std::invalid_argument("DataSetOptions: invalid argument for " + name + ": " + arg);
+    }
+
+    return static_cast<int>(val);
+}
+
+DataSetOptions DataSetOptions::parse(const std::string &spec)
+{
+    DataSetOptions opts;
+
+    if (spec.empty() || spec == "none") {
+        return opts;
+    }
+
+    size_t start = 0;
+    while (start <= spec.size()) {
+        size_t stop = spec.find(',', start);
+        if (stop == std::string::npos) {
+            stop = spec.size();
+        }
+
+        const std::string item = spec.substr(start, stop - start);
+        const size_t eq = item.find('=');
+        const std::string name = item.substr(0, eq);
+        const bool has_arg = eq != std::string::npos;
+        const std::string arg = has_arg ? item.substr(eq + 1) : "";
+
+        Filter f;
+        if (name == "shuffle") {
+            f = Filter::Shuffle;
+        } else if (name == "deflate" || name == "gzip") {
+            f = Filter::Deflate;
+            if (has_arg) {
+                opts.deflateLevel = static_cast<unsigned>(parse_filter_arg(name, arg, 1, 9));
+            }
+        } else if (name == "scaleoffset") {
+            f = Filter::ScaleOffset;
+            opts.scaleOffset = parse_filter_arg(name, arg, 0, 15);
+        } else if (name == "fletcher32") {
+            f = Filter::Fletcher32;
+        } else {
+            throw std::invalid_argument("DataSetOptions: unknown filter: " + item);
+        }
+
+        if (has_arg && (f == Filter::Shuffle || f == Filter::Fletcher32)) {
+            throw std::invalid_argument("DataSetOptions: " + name + " takes no argument");
+        } else if (opts.hasFilter(f)) {
+            throw std::invalid_argument("DataSetOptions: duplicate filter: " + name);
+        }
+
+        opts.filters.push_back(f);
+        start = stop + 1;
+    }
+
+    return opts;
+}
+
+static void require_filter(H5Z_filter_t id, DataSetOptions::Filter f)
+{
+    htri_t avail = H5Zfilter_avail(id);
+    if (avail <= 0) {
+        throw H5Exception("DataSetOptions: filter not available: " + to_string(f));
+    }
+}
+
+void DataSetOptions::applyCreate(hid_t dcpl, const DataType &fileType, const NDSize &size) const
+{
+    NDSize layout = chunks;
+
+    if (!layout && (guessChunks || !filters.empty()) && size) {
+        layout = DataSet::guessChunking(size, fileType.size());
+    }
+
+    if (layout) {
+        int rank = static_cast<int>(layout.size());
+        HErr res = H5Pset_chunk(dcpl, rank, layout.data());
+        res.check("DataSetOptions: Could not set chunk size");
+    } else if (!filters.empty()) {
+        throw std::invalid_argument("DataSetOptions: filters need a chunked DataSet");
+    }
+
+    for (Filter f : filters) {
+        HErr res;
+
+        switch (f) {
+        case Filter::ScaleOffset: {
+            require_filter(H5Z_FILTER_SCALEOFFSET, f);
+            const bool is_float = H5Tget_class(fileType.h5id()) == H5T_FLOAT;
+            if (is_float) {
+                res = H5Pset_scaleoffset(dcpl, H5Z_SO_FLOAT_DSCALE, scaleOffset);
+            } else {
+                res = H5Pset_scaleoffset(dcpl, H5Z_SO_INT, H5Z_SO_INT_MINBITS_DEFAULT);
+            }
+            break;
+        }
+
+        case Filter::Shuffle:
+            require_filter(H5Z_FILTER_SHUFFLE, f);
+            res = H5Pset_shuffle(dcpl);
+            break;
+
+        case Filter::Deflate:
+            require_filter(H5Z_FILTER_DEFLATE, f);
+            res = H5Pset_deflate(dcpl, deflateLevel);
+            break;
+
+        case Filter::Fletcher32:
+            require_filter(H5Z_FILTER_FLETCHER32, f);
+            res = H5Pset_fletcher32(dcpl);
+            break;
+        }
+
+        res.check("DataSetOptions: Could not set filter " + to_string(f));
+    }
+}
+
+size_t parse_bytes(const std::string &str)
+{
+    char *end = nullptr;
+    const unsigned long long val = std::strtoull(str.c_str(), &end, 10);
+
+    if (str.empty() || end == str.c_str() || str[0] == '-') {
+        throw std::invalid_argument("invalid size: " + str);
+    }
+
+    unsigned shift = 0;
+    const std::string suffix(end);
+    if (suffix == "K" || suffix == "k") {
+        shift = 10;
+    } else if (suffix == "M" || suffix == "m") {
+        shift = 20;
+    } else if (suffix == "G" || suffix == "g") {
+        shift = 30;
+    } else if (!suffix.empty()) {
+        throw std::invalid_argument("invalid size: " + str);
+    }
+
+    if (val > (std::numeric_limits<size_t>::max() >> shift)) {
+        throw std::out_of_range("size too large: " + str);
+    }
+
+    return static_cast<size_t>(val) << shift;
+}
+
+bool DataSetAccess::isDefault() const
+{
+    return cacheBytes == 0 && cacheSlots == 0 && cachePreemption < 0.0;
+}
+
+DataSetAccess DataSetAccess::parse(const std::string &spec)
+{
+    DataSetAccess access;
+
+    const size_t c1 = spec.find(':');
+    const size_t c2 = c1 == std::string::npos ? c1 : spec.find(':', c1 + 1);
+
+    access.cacheBytes = parse_bytes(spec.substr(0, c1));
+
+    if (c1 != std::string::npos) {
+        const std::string slots = spec.substr(c1 + 1, c2 == std::string::npos ? c2 : c2 - c1 - 1);
+        access.cacheSlots = static_cast<size_t>(parse_filter_arg("cache slots", slots, 1, std::numeric_limits<int>::max()));
+    }
+
+    if (c2 != std::string::npos) {
+        const std::string w0 = spec.substr(c2 + 1);
+        char *end = nullptr;
+        access.cachePreemption = std::strtod(w0.c_str(), &end);
+        if (w0.empty() || *end != '\0' || access.cachePreemption < 0.0 || access.cachePreemption > 1.0) {
+            throw std::invalid_argument("DataSetAccess: invalid preemption policy: " + w0);
+        }
+    }
+
+    return access;
+}
+
+void DataSetAccess::apply(hid_t dapl) const
+{
+    if (isDefault()) {
+        return;
+    }
+
+    size_t slots, bytes;
+    double w0;
+
+    HErr res = H5Pget_chunk_cache(dapl, &slots, &bytes, &w0);
+    res.check("DataSetAccess: Could not get chunk cache");
+
+    res = H5Pset_chunk_cache(dapl,
+                             cacheSlots > 0 ? cacheSlots : slots,
+                             cacheBytes > 0 ? cacheBytes : bytes,
+                             cachePreemption >= 0.0 ? std::min(cachePreemption, 1.0) : w0);
+    res.check("DataSetAccess: Could not set chunk cache");
+}
+
+std::string to_string(DataSetOptions::Filter filter)
+{
+    switch (filter) {
+    case DataSetOptions::Filter::ScaleOffset: return "scaleoffset";
+    case DataSetOptions::Filter::Shuffle:     return "shuffle";
+    case DataSetOptions::Filter::Deflate:     return "deflate";
+    case DataSetOptions::Filter::Fletcher32:  return "fletcher32";
+    }
+
+    return "unknown";
+}
+
+} // namespace h5x
@@ -0,0 +1,93 @@
+#ifndef H5X_DATASETOPTIONS_H
+#define H5X_DATASETOPTIONS_H
+
+#include <h5x/DataType.hpp>
+#include <h5x/NDSize.hpp>
+
+#include <hdf5.h>
+
+#include <string>
+#include <vector>
+
+namespace h5x {
+
+/**
+ * Parse a size in bytes with an optional K, M or G suffix (powers of 1024)
+ */
+size_t parse_bytes(const std::string &str);
+
+/**
+ * Access options of a DataSet: its chunk cache. Zero (or a negative
+ * preemption policy) keeps the default, which is the one of the File.
+ * A cache of a few chunks avoids reading and decompressing a chunk
+ * again for every partial access.
+ */
+struct DataSetAccess {
+    size_t cacheBytes = 0;
+    size_t cacheSlots = 0;        // hash slots, ideally a prime ~100x the chunks
+    double cachePreemption = -1.0; // w0: 0 evicts least recently used, 1 fully read chunks first
+
+    bool isDefault() const;
+
+    /**
+     * Parse "BYTES[:SLOTS[:W0]]", e.g. "16M:10007:0.75"
+     */
+    static DataSetAccess parse(const std::string &spec);
+
+    /**
+     * Set the chunk cache on a dataset access property list
+     */
+    void apply(hid_t dapl) const;
+};
+
+/**
+ * Creation options of a DataSet: chunk shape, filter pipeline and the
+ * chunk cache used while it is open. Filters need a chunked layout, if
+ * any are set and no chunk shape is given it is guessed.
+ */
+struct DataSetOptions {
+
+    enum class Filter {
+        ScaleOffset,   // lossy for floating point, see scaleOffset
+        Shuffle,       // byte shuffle, helps deflate on numeric data
+        Deflate,       // zlib, at deflateLevel
+        Fletcher32     // checksum of every chunk
+    };
+
+    // filters in the order they are applied on write
+    std::vector<Filter> filters;
+
+    unsigned deflateLevel = 4;  // 1 (fast) .. 9 (small)
+    int      scaleOffset = 6;   // decimal digits kept after the point for
+                                // floats; integers use the minimal bits
+
+    NDSize chunks;              // empty: guessed
+    bool   guessChunks = true;
+
+    DataSetAccess access;       // chunk cache while the DataSet is open
+
+    bool hasFilter(Filter f) const;
+
+    /**
+     * Shuffle followed by deflate at the given level
+     */
+    static DataSetOptions compressed(unsigned level = 4);
+
+    /**
+     * Parse a comma separated filter chain, e.g. "shuffle,deflate=6" or
+     * "scaleoffset=6,deflate,fletcher32"; "none" or "" for no filters.
+     * scaleoffset needs the number of decimal digits to keep
+     */
+    static DataSetOptions parse(const std::string &spec);
+
+    /**
+     * Set the layout and filters on a dataset creation property list
+     */
+    void applyCreate(hid_t dcpl, const DataType &fileType, const NDSize &size) const;
+};
+
+std::string to_string(DataSetOptions::Filter filter);
+
+} // namespace h5x
+
+#endif // H5X_DATASETOPTIONS_H
@@ -1,12 +1,65 @@
 
 #include "File.hpp"
+#include "Error.hpp"
 
 #include <sys/stat.h>
 
 namespace h5x {
 
+std::mutex &library_lock() {
+    static std::mutex lock;
+    return lock;
+}
+
 
 File File::open(const std::string &path, const std::string &mode) {
+    return open(path, mode, FileOptions());
+}
+
+
+// H5Fopen, silently retrying without the page buffer if the file was not
+// created with paged aggregation (which HDF5 refuses to open with one)
+static hid_t open_existing(const std::string &path, unsigned int flags, const FileOptions &options) {
+    HId fapl = H5Pcreate(H5P_FILE_ACCESS);
+    fapl.check("File::open(): Could not create file access plist");
+    options.applyAccess(fapl.h5id(), true);
+
+    if (options.pageBuffer == 0) {
+        return H5Fopen(path.c_str(), flags, fapl.h5id());
+    }
+
+    H5E_auto2_t func;
+    void *data;
+    H5Eget_auto2(H5E_DEFAULT, &func, &data);
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+    hid_t fd = H5Fopen(path.c_str(), flags, fapl.h5id());
+    H5Eset_auto2(H5E_DEFAULT, func, data);
+
+    if (fd < 0) {
+        fapl = H5Pcreate(H5P_FILE_ACCESS);
+        fapl.check("File::open(): Could not create file access plist");
+        options.applyAccess(fapl.h5id(), false);
+        fd = H5Fopen(path.c_str(), flags, fapl.h5id());
+    }
+
+    return fd;
+}
+
+
+static hid_t create_new(const std::string &path, const FileOptions &options) {
+    HId fcpl = H5Pcreate(H5P_FILE_CREATE);
+    fcpl.check("File::open(): Could not create file creation plist");
+    options.applyCreate(fcpl.h5id());
+
+    HId fapl = H5Pcreate(H5P_FILE_ACCESS);
+    fapl.check("File::open(): Could not create file access plist");
+    options.applyAccess(fapl.h5id(), true);
+
+    return H5Fcreate(path.c_str(), H5F_ACC_TRUNC, fcpl.h5id(), fapl.h5id());
+}
+
+
+File File::open(const std::string &path, const std::string &mode, const FileOptions &options) {
 
     if (mode.empty()) {
         throw std::invalid_argument("invalid open mode");
@@ -17,20 +70,20 @@ File File::open(const std::string &path, const std::string &mode) {
     File fd;
     if (p[0] == 'r') {
         unsigned int flags = p[1] == '+' ? H5F_ACC_RDWR : H5F_ACC_RDONLY;
-        fd = H5Fopen(path.c_str(), flags, H5P_DEFAULT);
+        fd = open_existing(path, flags, options);
     } else if (p[0] == 'w') {
-        fd = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+        fd = create_new(path, options);
     } else if (p[0] == 'a') {
         struct stat statbuf;
         int res = lstat(path.c_str(), &statbuf);
         if (res != 0) {
             if (errno == ENOENT) {
-                fd = H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+                fd = create_new(path, options);
             } else {
                 throw std::runtime_error("lstate failed");
             }
         } else {
-            fd = H5Fopen(path.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+            fd = open_existing(path, H5F_ACC_RDWR, options);
         }
     } else {
         throw std::invalid_argument("invalid open mode");
@@ -38,4 +91,21 @@ File File::open(const std::string &path, const std::string &mode) {
 
     return fd;
 }
-}
\ No newline at end of file
+
+void File::flush() {
+    HErr res = H5Fflush(hid, H5F_SCOPE_GLOBAL);
+    res.check("File::flush(): could not flush file");
+}
+
+void File::close() {
+    if (!H5Iis_valid(hid)) {
+        invalidate();
+        return;
+    }
+
+    HErr res = H5Fclose(hid);
+    invalidate();
+    res.check("File::close(): could not close file");
+}
+
+}
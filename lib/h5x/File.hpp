@@ -13,11 +13,20 @@
 #define H5X_H5FILE
 
 #include <h5x/Group.hpp>
+#include <h5x/FileOptions.hpp>
 
+#include <mutex>
 #include <string>
 #include <boost/optional.hpp>
 
 namespace h5x {
+
+/**
+ * The serial HDF5 library is not thread-safe: code that may use it from
+ * more than one thread at a time holds this while doing so.
+ */
+std::mutex &library_lock();
+
 class File : public Group {
 public:
     File() : Group() {}
@@ -26,6 +35,18 @@ public:
 
     static File open(const std::string &path, const std::string &mode);
 
+    /**
+     * Open with the given access options. With a page buffer, new files
+     * are created paged; existing files that are not are opened without it.
+     */
+    static File open(const std::string &path, const std::string &mode, const FileOptions &options);
+
+    void flush();
+
+    // closes the file if this is its last reference, and unlike for other
+    // objects a failure (e.g. writing out a core file) is an error
+    void close() override;
+
 };
 
 } // h5x::
@@ -0,0 +1,150 @@
+#include <h5x/FileOptions.hpp>
+#include <h5x/HId.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace h5x {
+
+bool FileOptions::isDefault() const
+{
+    return chunkCache.isDefault() && mdcInitial == 0 && mdcMax == 0 &&
+           !core && pageBuffer == 0 && pageSize == 0;
+}
+
+FileOptions FileOptions::parse(const std::string &spec)
+{
+    FileOptions opts;
+
+    size_t start = 0;
+    while (start < spec.size()) {
+        size_t stop = spec.find(',', start);
+        if (stop == std::string::npos) {
+            stop = spec.size();
+        }
+
+        const std::string item = spec.substr(start, stop - start);
+        const size_t eq = item.find('=');
+        const std::string name = item.substr(0, eq);
+        const std::string arg = eq == std::string::npos ? "" : item.substr(eq + 1);
+
+        if ((name == "core" || name == "memory") != arg.empty()) {
+            throw std::invalid_argument("FileOptions: invalid option: " + item);
+        }
+
+        if (name == "chunk-cache") {
+            opts.chunkCache = DataSetAccess::parse(arg);
+        } else if (name == "mdc") {
+            const size_t colon = arg.find(':');
+            if (colon == std::string::npos) {
+                opts.mdcMax = parse_bytes(arg);
+            } else {
+                opts.mdcInitial = parse_bytes(arg.substr(0, colon));
+                opts.mdcMax = parse_bytes(arg.substr(colon + 1));
+            }
+        } else if (name == "core") {
+            opts.core = true;
+            opts.coreBackingStore = true;
+        } else if (name == "memory") {
+            opts.core = true;
+            opts.coreBackingStore = false;
+        } else if (name == "page-buffer") {
+            opts.pageBuffer = parse_bytes(arg);
+        } else if (name == "page-size") {
+            opts.pageSize = parse_bytes(arg);
+        } else {
+            throw std::invalid_argument("FileOptions: unknown option: " + item);
+        }
+
+        start = stop + 1;
+    }
+
+    if (opts.mdcInitial > 0 && opts.mdcMax > 0 && opts.mdcInitial > opts.mdcMax) {
+        throw std::invalid_argument("FileOptions: initial metadata cache larger than its maximum");
+    }
+
+    if (opts.core && opts.pageBuffer > 0) {
+        throw std::invalid_argument("FileOptions: page buffering needs a file on disk");
+    }
+
+    return opts;
+}
+
+void FileOptions::applyAccess(hid_t fapl, bool paged) const
+{
+    HErr res;
+
+    if (!chunkCache.isDefault()) {
+        int mdc_nelmts;
+        size_t slots, bytes;
+        double w0;
+
+        res = H5Pget_cache(fapl, &mdc_nelmts, &slots, &bytes, &w0);
+        res.check("FileOptions: Could not get chunk cache");
+
+        res = H5Pset_cache(fapl, mdc_nelmts,
+                           chunkCache.cacheSlots > 0 ? chunkCache.cacheSlots : slots,
+                           chunkCache.cacheBytes > 0 ? chunkCache.cacheBytes : bytes,
+                           chunkCache.cachePreemption >= 0.0 ? chunkCache.cachePreemption : w0);
+        res.check("FileOptions: Could not set chunk cache");
+    }
+
+    if (mdcInitial > 0 || mdcMax > 0) {
+        H5AC_cache_config_t config;
+        config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+
+        res = H5Pget_mdc_config(fapl, &config);
+        res.check("FileOptions: Could not get metadata cache configuration");
+
+        if (mdcMax > 0) {
+            config.max_size = mdcMax;
+        }
+
+        if (mdcInitial > 0) {
+            config.set_initial_size = true;
+            config.initial_size = mdcInitial;
+            config.max_size = std::max(config.max_size, mdcInitial);
+        } else if (config.initial_size > config.max_size) {
+            config.set_initial_size = true;
+            config.initial_size = config.max_size;
+        }
+
+        config.min_size = std::min(config.min_size, config.initial_size);
+
+        res = H5Pset_mdc_config(fapl, &config);
+        res.check("FileOptions: Could not set metadata cache configuration");
+    }
+
+    if (core) {
+        res = H5Pset_fapl_core(fapl, coreIncrement, coreBackingStore);
+        res.check("FileOptions: Could not select the core driver");
+    }
+
+    if (pageBuffer > 0 && paged) {
+#if H5_VERSION_GE(1, 10, 1)
+        res = H5Pset_page_buffer_size(fapl, pageBuffer, 0, 0);
+        res.check("FileOptions: Could not set page buffer size");
+#else
+        throw std::invalid_argument("FileOptions: page buffering needs HDF5 1.10.1");
+#endif
+    }
+}
+
+void FileOptions::applyCreate(hid_t fcpl) const
+{
+    if (pageBuffer == 0 && pageSize == 0) {
+        return;
+    }
+
+#if H5_VERSION_GE(1, 10, 1)
+    HErr res = H5Pset_file_space_strategy(fcpl, H5F_FSPACE_STRATEGY_PAGE, false, 1);
+    res.check("FileOptions: Could not select paged aggregation");
+
+    res = H5Pset_file_space_page_size(fcpl, pageSize > 0 ? pageSize : 4096);
+    res.check("FileOptions: Could not set the page size");
+#else
+    throw std::invalid_argument("FileOptions: paged files need HDF5 1.10.1");
+#endif
+}
+
+} // namespace h5x
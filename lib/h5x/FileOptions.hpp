@@ -0,0 +1,69 @@
+#ifndef H5X_FILEOPTIONS_H
+#define H5X_FILEOPTIONS_H
+
+#include <h5x/DataSetOptions.hpp>
+
+#include <hdf5.h>
+
+#include <string>
+
+namespace h5x {
+
+/**
+ * Access options of a File. Everything zero or false keeps the
+ * defaults of HDF5, i.e. the sec2 driver with a 1 MiB chunk cache per
+ * DataSet and a metadata cache between 1 and 32 MiB.
+ */
+struct FileOptions {
+
+    // default chunk cache of every DataSet opened in the file
+    DataSetAccess chunkCache;
+
+    // metadata cache: initial and maximal size in bytes
+    size_t mdcInitial = 0;
+    size_t mdcMax = 0;
+
+    // keep the whole file in memory (core driver), growing it by
+    // coreIncrement; with coreBackingStore it is read from and written
+    // back to disk on close, without it is discarded
+    bool   core = false;
+    bool   coreBackingStore = true;
+    size_t coreIncrement = 1024 * 1024;
+
+    // page buffer of that many bytes; only applies to files created with
+    // paged aggregation, which new files are when pageBuffer is set,
+    // using pages of pageSize (4 KiB if 0). Other files are opened
+    // without it
+    size_t pageBuffer = 0;
+    size_t pageSize = 0;
+
+    bool isDefault() const;
+
+    /**
+     * Parse a comma separated list of
+     *   chunk-cache=BYTES[:SLOTS[:W0]]
+     *   mdc=[INITIAL:]MAX
+     *   core            (written back on close)
+     *   memory          (core, never written)
+     *   page-buffer=BYTES
+     *   page-size=BYTES
+     * e.g. "chunk-cache=16M:10007,mdc=4M:64M"; "" for the defaults
+     */
+    static FileOptions parse(const std::string &spec);
+
+    /**
+     * Set up a file access property list
+     *
+     * @param paged  Whether the page buffer is to be used
+     */
+    void applyAccess(hid_t fapl, bool paged = true) const;
+
+    /**
+     * Set up a file creation property list
+     */
+    void applyCreate(hid_t fcpl) const;
+};
+
+} // namespace h5x
+
+#endif // H5X_FILEOPTIONS_H
@@ -112,6 +112,21 @@ DataSet Group::createData(const std::string &name,
         NDSize chunks,
         bool max_size_unlimited,
         bool guess_chunks) const
+{
+    DataSetOptions options;
+    options.chunks = chunks;
+    options.guessChunks = guess_chunks;
+
+    return createData(name, fileType, size, options, maxsize, max_size_unlimited);
+}
+
+
+DataSet Group::createData(const std::string &name,
+        const h5x::DataType &fileType,
+        const NDSize &size,
+        const DataSetOptions &options,
+        const NDSize &maxsize,
+        bool max_size_unlimited) const
 {
     DataSpace space;
 
@@ -126,17 +141,14 @@ DataSet Group::createData(const std::string &name,
     HId dcpl = H5Pcreate(H5P_DATASET_CREATE);
     dcpl.check("Could not create data creation plist");
 
-    if (!chunks && guess_chunks) {
-        chunks = DataSet::guessChunking(size, fileType.size());
-    }
+    options.applyCreate(dcpl.h5id(), fileType, size);
 
-    if (chunks) {
-        int rank = static_cast<int>(chunks.size());
-        HErr res = H5Pset_chunk(dcpl.h5id(), rank, chunks.data());
-        res.check("Could not set chunk size on data set creation plist");
-    }
+    HId dapl = H5Pcreate(H5P_DATASET_ACCESS);
+    dapl.check("Could not create data access plist");
+
+    options.access.apply(dapl.h5id());
 
-    DataSet ds = H5Dcreate(hid, name.c_str(), fileType.h5id(), space.h5id(), H5P_DEFAULT, dcpl.h5id(), H5P_DEFAULT);
+    DataSet ds = H5Dcreate(hid, name.c_str(), fileType.h5id(), space.h5id(), H5P_DEFAULT, dcpl.h5id(), dapl.h5id());
     ds.check("Group::createData: Could not create DataSet with name " + name);
 
     return ds;
@@ -150,6 +162,18 @@ DataSet Group::openData(const std::string &name) const {
 }
 
 
+DataSet Group::openData(const std::string &name, const DataSetAccess &access) const {
+    HId dapl = H5Pcreate(H5P_DATASET_ACCESS);
+    dapl.check("Could not create data access plist");
+
+    access.apply(dapl.h5id());
+
+    DataSet ds = H5Dopen(hid, name.c_str(), dapl.h5id());
+    ds.check("Group::openData(): Could not open DataSet");
+    return ds;
+}
+
+
 bool Group::hasGroup(const std::string &name) const {
     return hasObject(name) && objectOfType(name, H5O_TYPE_GROUP);
 }
@@ -11,6 +11,7 @@
 
 #include <h5x/LocID.hpp>
 #include <h5x/DataSet.hpp>
+#include <h5x/DataSetOptions.hpp>
 #include <h5x/DataSpace.hpp>
 #include <h5x/Hydra.hpp>
 
@@ -45,7 +46,12 @@ public:
             const NDSize &size, const NDSize &maxsize = {}, NDSize chunks = {},
             bool maxSizeUnlimited = true, bool guessChunks = true) const;
 
+    DataSet createData(const std::string &name, const DataType &fileType,
+            const NDSize &size, const DataSetOptions &options,
+            const NDSize &maxsize = {}, bool maxSizeUnlimited = true) const;
+
     DataSet openData(const std::string &name) const;
+    DataSet openData(const std::string &name, const DataSetAccess &access) const;
     void removeData(const std::string &name);
 
     template<typename T>
@@ -21,6 +21,23 @@
 
 namespace h5x {
 
+/**
+ * Layout of a single value: made of elements of element_type, shape()
+ * of them. Specialise for structs that are nothing but an array of
+ * equal members (see h5x/hydra/iris.hpp); a container of them is then
+ * stored with the shape of the value as its trailing dimensions.
+ */
+template<typename T>
+struct element_traits {
+
+    typedef T element_type;
+
+    static NDSize shape() {
+        return NDSize();
+    }
+};
+
+
 template<typename T>
 struct data_traits {
 
@@ -28,32 +45,32 @@ struct data_traits {
     typedef value_type&       reference;
     typedef const value_type& const_reference;
 
-    typedef T        element_type;
-    typedef T*       element_pointer;
-    typedef const T* const_element_pointer;
+    typedef typename element_traits<T>::element_type element_type;
+    typedef element_type*       element_pointer;
+    typedef const element_type* const_element_pointer;
 
     static TypeId data_type(const_reference value) {
         return to_type_id<element_type>::value;
     }
 
     static NDSize shape(const_reference value) {
-        return NDSize();
+        return element_traits<T>::shape();
     }
 
     static size_t num_elements(const_reference value) {
-        return 1;
+        return element_traits<T>::shape().nelms();
     }
 
     static const_element_pointer get_data(const_reference value) {
-        return &value;
+        return reinterpret_cast<const_element_pointer>(&value);
     }
 
     static element_pointer get_data(reference value) {
-        return &value;
+        return reinterpret_cast<element_pointer>(&value);
     }
 
     static void resize(reference value, const NDSize &dims) {
-        if (!(dims.size() == 0 || dims.nelms() == 1)) {
+        if (dims.nelms() != element_traits<T>::shape().nelms()) {
             throw std::domain_error("Cannot resize scalar");
         }
     }
@@ -150,31 +167,56 @@ public:
     typedef value_type&        reference;
     typedef const value_type&  const_reference;
 
-    typedef T        element_type;
-    typedef T*       element_pointer;
-    typedef const T* const_element_pointer;
+    typedef typename element_traits<T>::element_type element_type;
+    typedef element_type*       element_pointer;
+    typedef const element_type* const_element_pointer;
 
     static TypeId data_type(const_reference val) {
         return to_type_id<element_type>::value;
     }
 
     static NDSize shape(const_reference value) {
-        return NDSize{value.size()};
+        const NDSize inner = element_traits<T>::shape();
+
+        NDSize dims(inner.size() + 1);
+        dims[0] = value.size();
+        for (size_t i = 0; i < inner.size(); i++) {
+            dims[i + 1] = inner[i];
+        }
+
+        return dims;
     }
 
     static size_t num_elements(const_reference value) {
-        return value.size();
+        return value.size() * element_traits<T>::shape().nelms();
     }
 
     static const_element_pointer get_data(const_reference value) {
-        return value.data();
+        return reinterpret_cast<const_element_pointer>(value.data());
     }
 
     static element_pointer get_data(value_type &value) {
-        return value.data();
+        return reinterpret_cast<element_pointer>(value.data());
     }
 
     static void resize(reference value, const NDSize &dims) {
+        const NDSize inner = element_traits<T>::shape();
+
+        if (inner.size() > 0) {
+            if (dims.size() != inner.size() + 1) {
+                throw std::domain_error("Cannot change rank of vector");
+            }
+
+            for (size_t i = 0; i < inner.size(); i++) {
+                if (dims[i + 1] != inner[i]) {
+                    throw std::domain_error("Cannot change shape of vector elements");
+                }
+            }
+
+            value.resize(check::fits_in_size_t(dims[0], "Can't resize: data to big for memory"));
+            return;
+        }
+
         size_t non_singletons = 0;
         size_t non_singleton_index = 0;
         for (size_t i = 0; i < dims.size(); ++i) {
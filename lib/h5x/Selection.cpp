@@ -27,6 +27,69 @@ void Selection::select(const NDSize &count, const NDSize &start, Mode mode)
 }
 
 
+/**
+ * Select count blocks of size block, stride apart, starting at start;
+ * e.g. every other row of a 2D space: count {n/2, 1}, stride {2, 1},
+ * block {1, ncols}
+ */
+void Selection::select(const NDSize &count, const NDSize &start,
+                       const NDSize &stride, const NDSize &block, Mode mode)
+{
+    H5S_seloper_t op = static_cast<H5S_seloper_t>(mode);
+    HErr status = H5Sselect_hyperslab(space.h5id(), op, start.data(), stride.data(), count.data(), block.data());
+    status.check("Selection::select(): Could not select hyperslab");
+}
+
+/**
+ * Select whole rows (along the first dimension) of the space. Runs of
+ * consecutive rows become a single block, so the resulting selection has
+ * as few blocks as possible. Rows must be strictly ascending: HDF5 always
+ * transfers selected elements in the order of the file space.
+ */
+void Selection::selectRows(const std::vector<ndsize_t> &rows)
+{
+    NDSize extent = space.extent();
+    if (extent.size() == 0) {
+        throw std::invalid_argument("Selection::selectRows(): scalar space");
+    }
+
+    HErr status = H5Sselect_none(space.h5id());
+    status.check("Selection::selectRows(): Could not clear selection");
+
+    NDSize start(extent.size(), 0);
+    NDSize count = extent;
+
+    for (size_t i = 0; i < rows.size();) {
+        if (rows[i] >= extent[0] || (i > 0 && rows[i] <= rows[i - 1])) {
+            throw std::invalid_argument("Selection::selectRows(): rows must be ascending and in range");
+        }
+
+        size_t k = i + 1;
+        while (k < rows.size() && rows[k] == rows[k - 1] + 1) {
+            k++;
+        }
+
+        start[0] = rows[i];
+        count[0] = k - i;
+        select(count, start, Mode::Or);
+
+        i = k;
+    }
+}
+
+/**
+ * Number of selected elements; unlike size() correct for selections
+ * made of several blocks
+ */
+ndsize_t Selection::elements() const
+{
+    hssize_t n = H5Sget_select_npoints(space.h5id());
+    if (n < 0) {
+        throw H5Exception("Selection::elements(): H5Sget_select_npoints failed");
+    }
+    return static_cast<ndsize_t>(n);
+}
+
 NDSize Selection::size() const
 {
     size_t rank = this->rank();
@@ -15,6 +15,8 @@
 
 #include <hdf5.h>
 
+#include <vector>
+
 
 namespace h5x {
 
@@ -44,6 +46,9 @@ public:
     Selection& operator=(const Selection &other) { space = other.space; return *this; }
 
     void select(const NDSize &count, const NDSize &start, Mode mode = Mode::Set);
+    void select(const NDSize &count, const NDSize &start,
+                const NDSize &stride, const NDSize &block, Mode mode = Mode::Set);
+    void selectRows(const std::vector<ndsize_t> &rows);
     void offset(const NDSSize &offset);
 
     DataSpace& h5space() { return space; }
@@ -51,6 +56,7 @@ public:
     bool isValid() const;
     void bounds(NDSize &start, NDSize &end) const;
     NDSize size() const;
+    ndsize_t elements() const;
     size_t rank() const;
 
 private:
@@ -0,0 +1,98 @@
+#ifndef HYDRA_IRIS_H
+#define HYDRA_IRIS_H
+
+#include <h5x/Hydra.hpp>
+
+#include <rgb.h>
+#include <dkl.h>
+#include <spectra.h>
+
+#include <type_traits>
+
+// Hydra support for the iris value types, so that they are read and
+// written straight from and to their own memory. rgb and sml are stored
+// as a trailing dimension of 3 (a std::vector<rgb> is an N×3 float
+// DataSet, like "patches" in the measurement files), spectra as a
+// num_spectra × num_samples float DataSet.
+
+namespace h5x {
+
+template<>
+struct element_traits<iris::rgb> {
+
+    typedef float element_type;
+
+    static NDSize shape() {
+        return NDSize{3};
+    }
+};
+
+static_assert(std::is_standard_layout<iris::rgb>::value && sizeof(iris::rgb) == 3 * sizeof(float),
+              "iris::rgb must be three packed floats");
+
+
+template<>
+struct element_traits<iris::sml> {
+
+    typedef double element_type;
+
+    static NDSize shape() {
+        return NDSize{3};
+    }
+};
+
+static_assert(std::is_standard_layout<iris::sml>::value && sizeof(iris::sml) == 3 * sizeof(double),
+              "iris::sml must be three packed doubles");
+
+
+template<>
+class data_traits<iris::spectra> {
+public:
+
+    typedef iris::spectra      value_type;
+    typedef value_type&        reference;
+    typedef const value_type&  const_reference;
+
+    typedef float        element_type;
+    typedef float*       element_pointer;
+    typedef const float* const_element_pointer;
+
+    static TypeId data_type(const_reference value) {
+        return TypeId::Float;
+    }
+
+    static NDSize shape(const_reference value) {
+        return NDSize{value.num_spectra(), value.num_samples()};
+    }
+
+    static size_t num_elements(const_reference value) {
+        return value.num_spectra() * value.num_samples();
+    }
+
+    static const_element_pointer get_data(const_reference value) {
+        return value.data();
+    }
+
+    static element_pointer get_data(reference value) {
+        return value.data();
+    }
+
+    // keeps the wavelengths, they are not part of the data
+    static void resize(reference value, const NDSize &dims) {
+        if (dims.size() != 2) {
+            throw std::domain_error("Cannot change rank of spectra");
+        }
+
+        if (dims[0] == value.num_spectra() && dims[1] == value.num_samples()) {
+            return;
+        }
+
+        value = iris::spectra(check::fits_in_size_t(dims[0], "Can't resize: data to big for memory"),
+                              check::fits_in_size_t(dims[1], "Can't resize: data to big for memory"),
+                              value.lambda_start(), value.lambda_step());
+    }
+};
+
+} // h5x::
+
+#endif // HYDRA_IRIS_H
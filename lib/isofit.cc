@@ -0,0 +1,184 @@
+#include <isofit.h>
+#include <catalog.h>
+#include <fit.h>
+#include <parallel.h>
+
+#include <chrono>
+#include <cmath>
+#include <memory>
+
+namespace iris {
+
+// bring a refit (A, phi) into the sign convention of the point
+// estimate and wrap the phase to within ±π around it
+static void align_phase(double A_ref, double phi_ref, double &A, double &phi) {
+    if ((A < 0) != (A_ref < 0)) {
+        A = -A;
+        phi += M_PI;
+    }
+
+    phi = phi_ref + std::remainder(phi - phi_ref, 2 * M_PI);
+}
+
+static void confidence_intervals(const std::vector<double> &x,
+                                 const std::vector<double> &y,
+                                 const sin_fitter &point,
+                                 const isofit_options &opts,
+                                 data::isoslant &iso,
+                                 isofit_report &report) {
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double, std::milli> ms;
+
+    bool fit_freq = point.fit_frequency;
+    double offset = point.fit_offset ? -1.0 : point.offset();
+
+    resampler rs([fit_freq, offset](const std::vector<double> &bx, const std::vector<double> &by) {
+        return std::unique_ptr<fitter>(new sin_fitter(bx, by, fit_freq, offset));
+    }, x, y);
+
+    auto columns = [&point](const resample_result &res, std::vector<double> &A, std::vector<double> &phi) {
+        A = res.column(0);
+        phi = res.column(1);
+        for (size_t i = 0; i < A.size(); i++) {
+            align_phase(point.amplitude(), point.phase(), A[i], phi[i]);
+        }
+    };
+
+    std::vector<double> A, phi;
+
+    if (opts.bootstrap > 0) {
+        auto start = clock::now();
+        resample_result res = rs.bootstrap(opts.bootstrap, 0, opts.threads);
+        report.t_boot = ms(clock::now() - start).count();
+        report.boot_refits = res.replicates;
+        report.boot_failed = res.failed;
+
+        if (!res.params.empty()) {
+            columns(res, A, phi);
+            auto dl_ci = resampler::percentile(A, opts.level);
+            auto phi_ci = resampler::percentile(phi, opts.level);
+
+            iso.ci_level = opts.level;
+            iso.ci_samples = res.params.size();
+            iso.dl_ci.lower = dl_ci.first;
+            iso.dl_ci.upper = dl_ci.second;
+            iso.phi_ci.lower = phi_ci.first;
+            iso.phi_ci.upper = phi_ci.second;
+        }
+    }
+
+    if (opts.jackknife) {
+        resample_result res = rs.jackknife(opts.threads);
+        columns(res, A, phi);
+        report.jack_failed = res.failed;
+        report.dl_se = resampler::jackknife_se(A);
+        report.phi_se = resampler::jackknife_se(phi);
+    }
+}
+
+bool fit_isoslant(const data::isodata &input, const isofit_options &opts, data::isoslant &iso,
+                  isofit_report *report) {
+    std::vector<double> x(input.samples.size());
+    std::vector<double> y(input.samples.size());
+
+    std::transform(input.samples.cbegin(), input.samples.cend(), x.begin(),
+                   [](const data::isodata::sample &s) {
+                       return s.stimulus;
+                   });
+
+    std::transform(input.samples.cbegin(), input.samples.cend(), y.begin(),
+                   [](const data::isodata::sample &s) {
+                       return s.response;
+                   });
+
+    isofit_report local;
+    isofit_report &rep = report ? *report : local;
+    rep = isofit_report();
+
+    sin_fitter fitter(x, y, opts.fit_frequency, opts.offset);
+    bool res = fitter();
+
+    rep.amplitude = fitter.amplitude();
+    rep.phase = fitter.phase();
+    rep.offset = fitter.offset();
+    rep.frequency = fitter.frequency();
+
+    if (!res) {
+        return false;
+    }
+
+    iso = data::isoslant(input.identifier());
+    iso.dl = fitter.amplitude();
+    iso.phi = fitter.phase();
+    iso.subject = input.subject;
+    iso.display = input.display;
+    iso.rgb2lms = input.rgb2lms;
+
+    if (opts.bootstrap > 0 || opts.jackknife) {
+        confidence_intervals(x, y, fitter, opts, iso, rep);
+    }
+
+    return true;
+}
+
+std::vector<batch_entry> batch_fit(const data::store &store,
+                                   const isofit_options &opts,
+                                   size_t nthreads) {
+    std::vector<batch_entry> entries = batch_fit(store.list_isodata(), opts, nthreads);
+
+    std::vector<std::pair<std::string, fs::file>> fitted;
+    for (const batch_entry &e : entries) {
+        if (e.success) {
+            fitted.emplace_back(e.output.parent().name(), e.output);
+        }
+    }
+
+    store.index().add_isoslants(fitted);
+
+    return entries;
+}
+
+std::vector<batch_entry> batch_fit(const std::vector<fs::file> &files,
+                                   const isofit_options &opts,
+                                   size_t nthreads) {
+    typedef std::chrono::steady_clock clock;
+    typedef std::chrono::duration<double, std::milli> ms;
+
+    std::vector<batch_entry> entries(files.size());
+
+    // the files are fitted in parallel already
+    isofit_options file_opts = opts;
+    file_opts.threads = 1;
+
+    parallel_for(files.size(), [&](size_t i, size_t worker) {
+        batch_entry &e = entries[i];
+        e.input = files[i];
+        e.success = false;
+        e.t_parse = e.t_fit = e.t_write = 0.0;
+
+        try {
+            auto t0 = clock::now();
+            data::isodata input = data::store::load_isodata(e.input);
+            auto t1 = clock::now();
+            e.success = fit_isoslant(input, file_opts, e.iso);
+            auto t2 = clock::now();
+
+            e.t_parse = ms(t1 - t0).count();
+            e.t_fit = ms(t2 - t1).count();
+
+            if (e.success) {
+                e.output = e.input.parent().child(e.iso.identifier() + ".isoslant");
+                e.output.atomic_write(data::store::isoslant2yaml(e.iso));
+                e.t_write = ms(clock::now() - t2).count();
+            }
+
+        } catch (const std::exception &ex) {
+            e.success = false;
+            e.error = ex.what();
+        }
+    }, nthreads);
+
+    return entries;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef IRIS_ISOFIT_H
+#define IRIS_ISOFIT_H
+
+#include <data.h>
+#include <fs.h>
+
+#include <string>
+#include <vector>
+
+namespace iris {
+
+struct isofit_options {
+    bool   fit_frequency = false;
+    double offset = -1.0; // < 0: fit it
+
+    // confidence intervals from refits of resampled data
+    size_t bootstrap = 0;     // bootstrap refits, 0: no intervals
+    double level = 0.95;      // of the percentile intervals, in (0, 1)
+    bool   jackknife = false; // jackknife standard errors
+    size_t threads = 0;       // for the refits, 0: all cores
+};
+
+// the fitted sinusoid and the resampling statistics, for reporting
+struct isofit_report {
+    double amplitude = 0.0;
+    double phase = 0.0;
+    double offset = 0.0;
+    double frequency = 0.0;
+
+    size_t boot_refits = 0;
+    size_t boot_failed = 0;
+    double t_boot = 0.0;      // in ms
+
+    size_t jack_failed = 0;
+    double dl_se = 0.0;       // jackknife standard errors
+    double phi_se = 0.0;
+};
+
+// isoslant from a sinusoid fitted to isodata, with confidence intervals
+// if requested; false if the fit failed. The report, if given, is filled
+// in either way.
+bool fit_isoslant(const data::isodata &input, const isofit_options &opts, data::isoslant &iso,
+                  isofit_report *report = nullptr);
+
+struct batch_entry {
+    fs::file input;
+    fs::file output;       // next to the input, <id>.isoslant
+    bool     success;
+    std::string error;     // non-empty if parsing or writing failed
+
+    data::isoslant iso;
+
+    double t_parse;        // in ms
+    double t_fit;
+    double t_write;
+};
+
+// fit all the isodata files in the store, writing the isoslants next to them
+std::vector<batch_entry> batch_fit(const data::store &store,
+                                   const isofit_options &opts,
+                                   size_t nthreads = 0);
+
+// same, for an explicit list of files
+std::vector<batch_entry> batch_fit(const std::vector<fs::file> &files,
+                                   const isofit_options &opts,
+                                   size_t nthreads = 0);
+
+}
+
+#endif
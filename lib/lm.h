@@ -0,0 +1,298 @@
+#ifndef IRIS_LM_H
+#define IRIS_LM_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace iris {
+
+/* Levenberg-Marquardt for small problems with at most N parameters.
+ *
+ * All N-sized state lives on the stack; the m-sized buffers (residuals,
+ * jacobian) are kept in a workspace that only ever grows, so repeated
+ * fits (bootstrap, batch fitting) do not allocate once it is warm.
+ *
+ * The Model is any fitter subclass (or anything with the same methods);
+ * its eval() and jacobian() are called non-virtually. Models without an
+ * analytic jacobian (has_jacobian() == false) use forward differences.
+ *
+ * Each step accumulates R and Q^T f of the jacobian by Givens rotations,
+ * row by row, and the damped system [R; sqrt(lambda) D] is reduced the
+ * same way, so the per-lambda cost does not depend on m.
+ */
+// m-sized buffers, shared by solvers of any N
+struct lm_workspace {
+    std::vector<double> fvec;
+    std::vector<double> ftrial;
+    std::vector<double> fjac; // column-major, m x n
+
+    void reserve(size_t m, size_t n) {
+        if (fvec.size() < m) {
+            fvec.resize(m);
+            ftrial.resize(m);
+        }
+
+        if (fjac.size() < m * n) {
+            fjac.resize(m * n);
+        }
+    }
+};
+
+template<size_t N>
+class lm_solver {
+public:
+    lm_solver() : tol(1.49012e-8), max_iterations(200) { }
+
+    template<typename Model>
+    bool operator()(Model &model, lm_workspace &ws);
+
+    // statistics of the last fit
+    int iterations() const { return n_iter; }
+    int evaluations() const { return n_eval; }
+    int jacobian_evaluations() const { return n_jac; }
+    double residual() const { return sumsq; } // sum of squares
+    // false if there were fewer residuals than parameters (minpack's info 0)
+    bool valid_input() const { return input_ok; }
+
+    double tol;
+    int    max_iterations;
+
+private:
+    typedef std::array<double, N> vec;
+    typedef std::array<vec, N>    mat;
+
+    static double sum_of_squares(const double *f, size_t m) {
+        double s = 0.0;
+        for (size_t i = 0; i < m; i++) {
+            s += f[i] * f[i];
+        }
+        return s;
+    }
+
+    // rotate the row (r, b) into the triangular (R, qtf), starting at column j0
+    static void givens_row(mat &R, vec &qtf, double *r, double &b, size_t j0, size_t n) {
+        for (size_t j = j0; j < n; j++) {
+            if (r[j] == 0.0) {
+                continue;
+            }
+
+            const double h = std::hypot(R[j][j], r[j]);
+            const double c = R[j][j] / h;
+            const double s = r[j] / h;
+
+            R[j][j] = h;
+            r[j] = 0.0;
+
+            for (size_t k = j + 1; k < n; k++) {
+                const double rk = R[j][k];
+                R[j][k] = c * rk + s * r[k];
+                r[k] = -s * rk + c * r[k];
+            }
+
+            const double qb = qtf[j];
+            qtf[j] = c * qb + s * b;
+            b = -s * qb + c * b;
+        }
+    }
+
+private:
+    int    n_iter = 0;
+    int    n_eval = 0;
+    int    n_jac = 0;
+    double sumsq = 0.0;
+    bool   input_ok = true;
+};
+
+
+template<size_t N>
+template<typename Model>
+bool lm_solver<N>::operator()(Model &model, lm_workspace &ws) {
+    const int mi = model.Model::num_variables();
+    const int ni = model.Model::num_parameter();
+
+    if (ni < 1 || static_cast<size_t>(ni) > N) {
+        throw std::invalid_argument("lm_solver: invalid number of parameters");
+    }
+
+    n_iter = n_eval = n_jac = 0;
+    sumsq = 0.0;
+    input_ok = mi >= ni;
+
+    if (!input_ok) {
+        return false; // e.g. a refit of too few samples, not a bug
+    }
+
+    const size_t m = static_cast<size_t>(mi);
+    const size_t n = static_cast<size_t>(ni);
+    const bool analytic = model.Model::has_jacobian();
+
+    ws.reserve(m, n);
+    double *fvec = ws.fvec.data();
+    double *ftrial = ws.ftrial.data();
+    double *fjac = ws.fjac.data();
+
+    double *p = model.Model::params();
+
+    vec diag{};
+    vec trial{};
+
+    model.Model::eval(mi, ni, p, fvec);
+    n_eval++;
+    sumsq = sum_of_squares(fvec, m);
+
+    double lambda = -1.0;
+    double nu = 2.0;
+
+    while (n_iter++ < max_iterations) {
+
+        if (analytic) {
+            model.Model::jacobian(mi, ni, p, fjac, mi);
+            n_jac++;
+        } else {
+            const double eps = std::sqrt(std::numeric_limits<double>::epsilon());
+            for (size_t j = 0; j < n; j++) {
+                const double pj = p[j];
+                const double h = eps * (pj != 0.0 ? std::abs(pj) : 1.0);
+                p[j] = pj + h;
+                model.Model::eval(mi, ni, p, ftrial);
+                n_eval++;
+                p[j] = pj;
+
+                for (size_t i = 0; i < m; i++) {
+                    fjac[i + j*m] = (ftrial[i] - fvec[i]) / h;
+                }
+            }
+        }
+
+        // QR of the jacobian: R and Q^T f
+        mat R{};
+        vec qtf{};
+        vec row{};
+
+        for (size_t i = 0; i < m; i++) {
+            for (size_t j = 0; j < n; j++) {
+                row[j] = fjac[i + j*m];
+            }
+            double b = fvec[i];
+            givens_row(R, qtf, row.data(), b, 0, n);
+        }
+
+        // column norms of J (= of R) for scaling, and the gradient J^T f = R^T qtf
+        double gmax = 0.0;
+        double dmax = 0.0;
+        for (size_t j = 0; j < n; j++) {
+            double cn = 0.0;
+            double g = 0.0;
+            for (size_t k = 0; k <= j; k++) {
+                cn += R[k][j] * R[k][j];
+                g += R[k][j] * qtf[k];
+            }
+            cn = std::sqrt(cn);
+
+            diag[j] = std::max(diag[j], cn > 0.0 ? cn : 1.0);
+            dmax = std::max(dmax, diag[j]);
+
+            if (cn > 0.0 && sumsq > 0.0) {
+                gmax = std::max(gmax, std::abs(g) / (cn * std::sqrt(sumsq)));
+            }
+        }
+
+        if (sumsq == 0.0 || gmax <= tol) {
+            return true;
+        }
+
+        if (lambda < 0.0) {
+            lambda = 1e-3 * dmax * dmax;
+        }
+
+        // inner loop: find an acceptable damped step
+        while (true) {
+            mat Rd = R;
+            vec z = qtf;
+
+            const double sl = std::sqrt(lambda);
+            for (size_t j = 0; j < n; j++) {
+                vec d{};
+                d[j] = sl * diag[j];
+                double b = 0.0;
+                givens_row(Rd, z, d.data(), b, j, n);
+            }
+
+            // R_d step = -z
+            vec step{};
+            for (size_t jj = n; jj-- > 0;) {
+                double v = -z[jj];
+                for (size_t k = jj + 1; k < n; k++) {
+                    v -= Rd[jj][k] * step[k];
+                }
+                step[jj] = v / Rd[jj][jj];
+            }
+
+            // predicted reduction from the linear model |f + J step|^2
+            double lin = sumsq;
+            for (size_t j = 0; j < n; j++) {
+                double rs = qtf[j];
+                for (size_t k = j; k < n; k++) {
+                    rs += R[j][k] * step[k];
+                }
+                lin += rs * rs - qtf[j] * qtf[j];
+            }
+            const double predicted = sumsq - lin;
+
+            double pnorm = 0.0;
+            double snorm = 0.0;
+            for (size_t j = 0; j < n; j++) {
+                trial[j] = p[j] + step[j];
+                pnorm += diag[j] * diag[j] * p[j] * p[j];
+                snorm += diag[j] * diag[j] * step[j] * step[j];
+            }
+
+            model.Model::eval(mi, ni, trial.data(), ftrial);
+            n_eval++;
+            const double trial_sumsq = sum_of_squares(ftrial, m);
+
+            const double rho = predicted > 0.0 ? (sumsq - trial_sumsq) / predicted : -1.0;
+
+            if (rho > 0.0 && std::isfinite(trial_sumsq)) {
+                const double reduction = sumsq - trial_sumsq;
+
+                std::copy(trial.begin(), trial.begin() + n, p);
+                std::swap(ws.fvec, ws.ftrial);
+                fvec = ws.fvec.data();
+                ftrial = ws.ftrial.data();
+                sumsq = trial_sumsq;
+
+                const double t = 2.0 * rho - 1.0;
+                lambda *= std::max(1.0 / 3.0, 1.0 - t * t * t);
+                nu = 2.0;
+
+                if (reduction <= tol * (sumsq + reduction) ||
+                    std::sqrt(snorm) <= tol * (std::sqrt(pnorm) + tol)) {
+                    return true;
+                }
+
+                break;
+            }
+
+            lambda *= nu;
+            nu *= 2.0;
+
+            if (!std::isfinite(lambda) || lambda > 1e32 ||
+                std::sqrt(snorm) <= std::numeric_limits<double>::epsilon() * std::sqrt(pnorm)) {
+                // cannot make progress anymore, we are at the minimum
+                // as far as numerical precision goes
+                return std::isfinite(sumsq);
+            }
+        }
+    }
+
+    return false;
+}
+
+}
+
+#endif
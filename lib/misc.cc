@@ -23,4 +23,10 @@ std::string make_timestamp() {
     return std::string(buffer, res);
 }
 
+std::string digest::hex() const {
+    std::stringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << h;
+    return out.str();
+}
+
 }
\ No newline at end of file
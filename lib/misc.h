@@ -6,6 +6,8 @@
 #include <vector>
 #include <cmath>
 #include <string>
+#include <cstdint>
+#include <type_traits>
 
 namespace iris {
 
@@ -61,6 +63,47 @@ T visual_angle_to_size(T angle, T distance) {
 
 std::string make_timestamp();
 
+// 64-bit FNV-1a over everything passed to update(); a content hash for
+// cache keys, not a cryptographic one
+class digest {
+public:
+    digest() : h(14695981039346656037ULL) { }
+
+    digest &update(const void *data, size_t n) {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < n; i++) {
+            h = (h ^ p[i]) * 1099511628211ULL;
+        }
+        return *this;
+    }
+
+    // strings and vectors are length-prefixed, so that
+    // ("ab", "c") and ("a", "bc") do not collide
+    digest &update(const std::string &str) {
+        value(str.size());
+        return update(str.data(), str.size());
+    }
+
+    template<typename T>
+    digest &update(const std::vector<T> &v) {
+        static_assert(std::is_trivially_copyable<T>::value, "digest: need plain data");
+        value(v.size());
+        return update(v.data(), v.size() * sizeof(T));
+    }
+
+    template<typename T>
+    digest &value(const T &v) {
+        static_assert(std::is_arithmetic<T>::value, "digest: need arithmetic type");
+        return update(&v, sizeof(T));
+    }
+
+    uint64_t get() const { return h; }
+    std::string hex() const;
+
+private:
+    uint64_t h;
+};
+
 }
 
 #endif
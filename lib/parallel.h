@@ -0,0 +1,68 @@
+#ifndef IRIS_PARALLEL_H
+#define IRIS_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iris {
+
+inline size_t hardware_threads() {
+    unsigned int n = std::thread::hardware_concurrency();
+    return n > 0 ? n : 1;
+}
+
+// Calls fn(index, worker) for every index in [0, n) on up to nthreads
+// threads (0 means one per core); worker is in [0, nthreads) and can be
+// used to address per-thread state. The calling thread is worker 0.
+// The first exception thrown by fn stops the loop and is rethrown.
+template<typename F>
+void parallel_for(size_t n, F fn, size_t nthreads = 0) {
+
+    if (nthreads == 0) {
+        nthreads = hardware_threads();
+    }
+
+    nthreads = std::max<size_t>(1, std::min(nthreads, n));
+
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto work = [&](size_t worker) {
+        size_t i;
+        while ((i = next++) < n) {
+            try {
+                fn(i, worker);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                next = n;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t k = 1; k < nthreads; k++) {
+        threads.emplace_back(work, k);
+    }
+
+    work(0);
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}
+
+#endif
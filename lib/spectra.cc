@@ -57,12 +57,16 @@ double spectrum::integrate() const {
 
 
 spectra spectra::from_csv(const fs::file &path) {
-    std::string data = path.read_all();
-    return spectra::from_csv(data);
+    fs::mapped_file data = path.map();
+    return spectra::from_csv(data.begin(), data.end());
 }
 
 spectra spectra::from_csv(const std::string &data) {
-    typedef csv_iterator<std::string::const_iterator> csv_siterator;
+    return spectra::from_csv(data.data(), data.data() + data.size());
+}
+
+spectra spectra::from_csv(const char *first, const char *last) {
+    typedef csv_iterator<const char *> csv_siterator;
 
     std::vector<uint16_t> lambda;
 
@@ -71,7 +75,7 @@ spectra spectra::from_csv(const std::string &data) {
     bool first_line = true;
     std::vector<std::string> header;
 
-    for (auto iter = csv_siterator(data.begin(), data.end(), ',');
+    for (auto iter = csv_siterator(first, last, ',');
          iter != csv_siterator();
          ++iter) {
         const auto &line = *iter;
@@ -5,6 +5,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <utility>
 
 #include <fs.h>
 
@@ -84,6 +85,7 @@ public:
 
     static spectra from_csv(const std::string &str);
     static spectra from_csv(const fs::file &path);
+    static spectra from_csv(const char *first, const char *last);
     void to_csv(std::ostream &out) const;
 
 public:
@@ -102,6 +104,18 @@ public:
         o.n_samples = 0;
     }
 
+    spectra &operator=(spectra &&o) {
+        if (this != &o) {
+            std::swap(storage, o.storage);
+            std::swap(n_spectra, o.n_spectra);
+            std::swap(n_samples, o.n_samples);
+            wl_start = o.wl_start;
+            wl_step = o.wl_step;
+            ids = std::move(o.ids);
+        }
+        return *this;
+    }
+
     ~spectra() {
         if (storage != nullptr) {
             std::allocator<float> al;
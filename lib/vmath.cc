@@ -0,0 +1,187 @@
+#include <vmath.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+namespace iris {
+namespace vmath {
+
+static const double exp_lo = -708.39;   // below: result not normal anymore
+static const double exp_hi = 709.78;    // above: overflow
+static const double log2e = 1.4426950408889634;
+static const double ln2_hi = 0.693147180369123816490;    // upper bits of ln(2)
+static const double ln2_lo = 1.90821492927058770002e-10; // ln(2) - ln2_hi
+
+// 1/k!, k = 13 .. 0 for Horner's scheme
+static const double exp_coeff[] = {
+        1.0 / 6227020800.0, 1.0 / 479001600.0, 1.0 / 39916800.0, 1.0 / 3628800.0,
+        1.0 / 362880.0, 1.0 / 40320.0, 1.0 / 5040.0, 1.0 / 720.0,
+        1.0 / 120.0, 1.0 / 24.0, 1.0 / 6.0, 1.0 / 2.0,
+        1.0, 1.0
+};
+
+static const size_t exp_ncoeff = sizeof(exp_coeff) / sizeof(exp_coeff[0]);
+
+static inline double exp_scalar(double x) {
+    if (!(x >= exp_lo)) {
+        return std::isnan(x) ? x : 0.0;
+    } else if (x > exp_hi) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    const double k = std::nearbyint(x * log2e);
+    const double r = (x - k * ln2_hi) - k * ln2_lo;
+
+    double p = exp_coeff[0];
+    for (size_t i = 1; i < exp_ncoeff; i++) {
+        p = p * r + exp_coeff[i];
+    }
+
+    // 2^k in two halves, k itself can exceed the exponent range at the edges
+    const int64_t ki = static_cast<int64_t>(k);
+    const int64_t k1 = ki / 2;
+    const int64_t k2 = ki - k1;
+
+    int64_t bits1 = (k1 + 1023) << 52;
+    int64_t bits2 = (k2 + 1023) << 52;
+
+    double s1, s2;
+    memcpy(&s1, &bits1, sizeof(s1));
+    memcpy(&s2, &bits2, sizeof(s2));
+
+    return p * s1 * s2;
+}
+
+#ifdef HAVE_AVX2_KERNEL
+
+__attribute__((target("avx2,fma")))
+static size_t exp_ax_avx2(const double *x, double a, double *out, size_t n) {
+    const __m256d va = _mm256_set1_pd(a);
+    const __m256d vlo = _mm256_set1_pd(exp_lo);
+    const __m256d vhi = _mm256_set1_pd(exp_hi);
+    const __m256d vinf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d vlog2e = _mm256_set1_pd(log2e);
+    const __m256d vln2_hi = _mm256_set1_pd(ln2_hi);
+    const __m256d vln2_lo = _mm256_set1_pd(ln2_lo);
+    const __m128i bias = _mm_set1_epi32(1023);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d v = _mm256_mul_pd(va, _mm256_loadu_pd(x + i));
+
+        // lanes outside [lo, hi] are fixed up below, clamp to keep k sane
+        __m256d in_range = _mm256_cmp_pd(v, vlo, _CMP_GE_OQ);
+        __m256d overflow = _mm256_cmp_pd(v, vhi, _CMP_GT_OQ);
+        __m256d nan = _mm256_cmp_pd(v, v, _CMP_UNORD_Q);
+        __m256d vc = _mm256_min_pd(_mm256_max_pd(v, vlo), vhi);
+
+        __m256d k = _mm256_round_pd(_mm256_mul_pd(vc, vlog2e), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256d r = _mm256_fnmadd_pd(k, vln2_hi, vc);
+        r = _mm256_fnmadd_pd(k, vln2_lo, r);
+
+        __m256d p = _mm256_set1_pd(exp_coeff[0]);
+        for (size_t c = 1; c < exp_ncoeff; c++) {
+            p = _mm256_fmadd_pd(p, r, _mm256_set1_pd(exp_coeff[c]));
+        }
+
+        __m128i ki = _mm256_cvtpd_epi32(k);
+        __m128i k1 = _mm_srai_epi32(ki, 1);
+        __m128i k2 = _mm_sub_epi32(ki, k1);
+        __m256i b1 = _mm256_slli_epi64(_mm256_cvtepi32_epi64(_mm_add_epi32(k1, bias)), 52);
+        __m256i b2 = _mm256_slli_epi64(_mm256_cvtepi32_epi64(_mm_add_epi32(k2, bias)), 52);
+        __m256d res = _mm256_mul_pd(_mm256_mul_pd(p, _mm256_castsi256_pd(b1)), _mm256_castsi256_pd(b2));
+
+        res = _mm256_and_pd(res, in_range);
+        res = _mm256_blendv_pd(res, vinf, overflow);
+        res = _mm256_blendv_pd(res, v, nan);
+
+        _mm256_storeu_pd(out + i, res);
+    }
+
+    return i;
+}
+
+static bool have_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return supported;
+}
+
+#endif
+
+void exp_ax(const double *x, double a, double *out, size_t n) {
+    if (a == 0.0) {
+        std::fill(out, out + n, 1.0); // pow(y, 0), also for y = 0
+        return;
+    }
+
+    size_t i = 0;
+
+#ifdef HAVE_AVX2_KERNEL
+    if (have_avx2()) {
+        i = exp_ax_avx2(x, a, out, n);
+    }
+#endif
+
+    for (; i < n; i++) {
+        out[i] = exp_scalar(a * x[i]);
+    }
+}
+
+double exp_ax_error(size_t n) {
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> arg(exp_lo, exp_hi);
+
+    std::vector<double> x(n), out(n);
+    for (double &v : x) {
+        v = arg(rng);
+    }
+
+    exp_ax(x.data(), 1.0, out.data(), n);
+
+    double max_error = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        const long double ref = std::exp(static_cast<long double>(x[i]));
+        const long double simd = (out[i] - ref) / ref;
+        const long double scalar = (exp_scalar(x[i]) - ref) / ref;
+        max_error = std::max(max_error, static_cast<double>(std::fabs(simd)));
+        max_error = std::max(max_error, static_cast<double>(std::fabs(scalar)));
+    }
+
+    // exp(a * log(0)) must be pow(0, a): 1, 0 and inf for a = 0, 1, -1;
+    // five lanes, to go through both kernels
+    const double inf = std::numeric_limits<double>::infinity();
+    const double a[3] = {0.0, 1.0, -1.0};
+    const double expected[3] = {1.0, 0.0, inf};
+    const double zero[5] = {-inf, -inf, -inf, -inf, -inf};
+
+    for (size_t k = 0; k < 3; k++) {
+        double res[5];
+        exp_ax(zero, a[k], res, 5);
+        for (double r : res) {
+            if (r != expected[k]) {
+                return inf;
+            }
+        }
+    }
+
+    return max_error;
+}
+
+void log(const double *x, double *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = std::log(x[i]);
+    }
+}
+
+} //iris::vmath::
+} //iris::
@@ -0,0 +1,34 @@
+#ifndef IRIS_VMATH_H
+#define IRIS_VMATH_H
+
+#include <cstddef>
+
+namespace iris {
+namespace vmath {
+
+/* out[i] = exp(a * x[i]) over contiguous arrays.
+ *
+ * Range reduction to |r| <= ln(2)/2 and a degree 13 polynomial; the
+ * relative error is below 4e-16 (< 2 ulp) for arguments >= -708.39,
+ * smaller arguments (incl. -inf, e.g. from log(0)) yield 0. Uses AVX2
+ * and FMA if the cpu supports them, a scalar loop otherwise.
+ *
+ * With x[i] = log(y[i]) this is pow(y[i], a), and like pow it is 1 for
+ * a == 0 even if y[i] is 0 (x[i] = -inf), where a * x[i] would be NaN.
+ */
+void exp_ax(const double *x, double a, double *out, size_t n);
+
+/* Self-check of exp_ax: the largest relative error, against std::exp in
+ * long double, over n random arguments in the range above, of both the
+ * SIMD and the scalar kernel; infinity if the pow() conventions for
+ * y = 0 (x = -inf) do not hold.
+ */
+double exp_ax_error(size_t n = 1 << 20);
+
+// natural logarithm, element-wise; used to precompute exponents
+void log(const double *x, double *out, size_t n);
+
+} //iris::vmath::
+} //iris::
+
+#endif
@@ -0,0 +1,374 @@
+#include <walk.h>
+#include <parallel.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fs {
+
+namespace {
+
+struct child {
+    walk_entry entry;
+    bool       descend;
+};
+
+// read one directory, deciding for every sub-directory whether to descend
+void read_dir(const walk_entry &dir, const walk_options &opts, std::vector<child> &out) {
+    fs::file::dir_enum entries = dir.file.children(opts.hidden ? "" : "*");
+
+    for (fs::dir_iterator it = entries.begin(); it != entries.end(); ++it) {
+        child c{walk_entry{*it, it.type(), dir.depth + 1}, false};
+
+        if (c.entry.type == file_type::directory &&
+            c.entry.depth < opts.max_depth &&
+            (opts.follow_links || !it.is_link())) {
+            c.descend = !opts.descend || opts.descend(c.entry);
+        }
+
+        out.push_back(std::move(c));
+    }
+}
+
+size_t thread_count(const walk_options &opts) {
+    return opts.nthreads > 0 ? opts.nthreads : iris::hardware_threads();
+}
+
+// unordered: work-stealing over per-worker deques of directories
+
+struct worker_queue {
+    std::mutex lock;
+    std::deque<walk_entry> dirs;
+};
+
+size_t walk_unordered(const walk_entry &root,
+                      const std::function<void(const walk_entry &)> &fn,
+                      const walk_options &opts) {
+    const size_t nthreads = thread_count(opts);
+
+    std::vector<worker_queue> queues(nthreads);
+    queues[0].dirs.push_back(root);
+
+    std::atomic<size_t> pending(1); // directories queued or being read
+    std::atomic<size_t> queued(1);  // directories queued
+    std::atomic<size_t> count(0);
+    std::atomic<bool> stop(false);
+
+    // workers without anything to steal sleep here until a directory is
+    // queued or the walk is over
+    std::mutex idle_lock;
+    std::condition_variable cv_idle;
+    std::atomic<size_t> sleeping(0);
+
+    auto wake_all = [&]() {
+        std::lock_guard<std::mutex> guard(idle_lock);
+        cv_idle.notify_all();
+    };
+
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto work = [&](size_t self) {
+        std::vector<child> children;
+
+        while (!stop) {
+            walk_entry dir;
+            bool have = false;
+
+            {   // own work, newest first: depth-first
+                std::lock_guard<std::mutex> guard(queues[self].lock);
+                if (!queues[self].dirs.empty()) {
+                    dir = std::move(queues[self].dirs.back());
+                    queues[self].dirs.pop_back();
+                    queued--;
+                    have = true;
+                }
+            }
+
+            for (size_t k = 1; !have && k < nthreads; k++) {
+                worker_queue &victim = queues[(self + k) % nthreads];
+                std::lock_guard<std::mutex> guard(victim.lock);
+                if (!victim.dirs.empty()) {
+                    dir = std::move(victim.dirs.front());
+                    victim.dirs.pop_front();
+                    queued--;
+                    have = true;
+                }
+            }
+
+            if (!have) {
+                std::unique_lock<std::mutex> guard(idle_lock);
+                sleeping++;
+                cv_idle.wait(guard, [&]() {
+                    return queued > 0 || pending == 0 || stop;
+                });
+                sleeping--;
+
+                if (pending == 0) {
+                    return;
+                }
+                continue;
+            }
+
+            try {
+                children.clear();
+                read_dir(dir, opts, children);
+
+                for (const child &c : children) {
+                    fn(c.entry);
+                    count++;
+
+                    if (c.descend) {
+                        pending++;
+                        queued++; // before the push, so it never underflows
+                        {
+                            std::lock_guard<std::mutex> guard(queues[self].lock);
+                            queues[self].dirs.push_back(c.entry);
+                        }
+
+                        if (sleeping > 0) {
+                            std::lock_guard<std::mutex> guard(idle_lock);
+                            cv_idle.notify_one();
+                        }
+                    }
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(error_lock);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                stop = true;
+                wake_all();
+            }
+
+            if (--pending == 0) {
+                wake_all();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t k = 1; k < nthreads; k++) {
+        threads.emplace_back(work, k);
+    }
+
+    work(0);
+
+    for (std::thread &t : threads) {
+        t.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    return count;
+}
+
+// ordered: the calling thread consumes the directories in pre-order,
+// the workers read ahead up to a bounded number of them
+
+struct listing {
+    enum class state { idle, queued, running, done };
+
+    explicit listing(const walk_entry &dir) : dir(dir) { }
+
+    walk_entry dir;
+    state st = state::idle;
+    std::vector<child> children;
+    std::exception_ptr error;
+};
+
+typedef std::shared_ptr<listing> listing_ptr;
+
+class read_ahead {
+public:
+    read_ahead(const walk_options &opts, size_t nthreads)
+            : opts(opts), window(4 * nthreads), outstanding(0), shutdown(false) {
+        for (size_t k = 0; k < nthreads; k++) {
+            threads.emplace_back([this]() { work(); });
+        }
+    }
+
+    ~read_ahead() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            shutdown = true;
+        }
+        cv_work.notify_all();
+
+        for (std::thread &t : threads) {
+            t.join();
+        }
+    }
+
+    // queue l unless it already is; false if the window is full
+    bool request(const listing_ptr &l) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (l->st != listing::state::idle) {
+            return true;
+        } else if (outstanding >= window) {
+            return false;
+        }
+
+        l->st = listing::state::queued;
+        queue.push_back(l);
+        outstanding++;
+        cv_work.notify_one();
+        return true;
+    }
+
+    // the children of l, read here if nobody has started yet
+    void wait(const listing_ptr &l) {
+        std::unique_lock<std::mutex> guard(lock);
+
+        if (l->st == listing::state::idle) {
+            l->st = listing::state::running;
+            guard.unlock();
+            run(*l);
+            guard.lock();
+            l->st = listing::state::done;
+        } else {
+            cv_done.wait(guard, [&l]() { return l->st == listing::state::done; });
+            outstanding--;
+        }
+
+        if (l->error) {
+            std::rethrow_exception(l->error);
+        }
+    }
+
+private:
+    void run(listing &l) {
+        try {
+            read_dir(l.dir, opts, l.children);
+            std::sort(l.children.begin(), l.children.end(), [](const child &a, const child &b) {
+                return a.entry.file.path() < b.entry.file.path();
+            });
+        } catch (...) {
+            l.error = std::current_exception();
+        }
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> guard(lock);
+
+        while (true) {
+            cv_work.wait(guard, [this]() { return shutdown || !queue.empty(); });
+            if (shutdown) {
+                return;
+            }
+
+            listing_ptr l = queue.front();
+            queue.pop_front();
+            l->st = listing::state::running;
+
+            guard.unlock();
+            run(*l);
+            guard.lock();
+
+            l->st = listing::state::done;
+            cv_done.notify_all();
+        }
+    }
+
+private:
+    const walk_options &opts;
+    const size_t window;
+
+    std::mutex lock;
+    std::condition_variable cv_work;
+    std::condition_variable cv_done;
+    std::deque<listing_ptr> queue;
+    size_t outstanding; // queued, running or done but not consumed
+    bool shutdown;
+
+    std::vector<std::thread> threads;
+};
+
+size_t walk_ordered(const walk_entry &root,
+                    const std::function<void(const walk_entry &)> &fn,
+                    const walk_options &opts) {
+    struct frame {
+        listing_ptr l;
+        size_t next;
+        std::vector<listing_ptr> subdirs; // one per child, null if not descended
+    };
+
+    read_ahead reader(opts, thread_count(opts));
+    std::vector<frame> stack;
+    size_t count = 0;
+
+    auto open = [&](const listing_ptr &l) {
+        reader.wait(l);
+
+        frame f{l, 0, std::vector<listing_ptr>(l->children.size())};
+        for (size_t i = 0; i < l->children.size(); i++) {
+            if (l->children[i].descend) {
+                f.subdirs[i] = std::make_shared<listing>(l->children[i].entry);
+            }
+        }
+        stack.push_back(std::move(f));
+
+        // read ahead what is needed next: the sub-directories of the
+        // innermost directories first
+        for (auto fi = stack.rbegin(); fi != stack.rend(); ++fi) {
+            for (size_t i = fi->next; i < fi->subdirs.size(); i++) {
+                if (fi->subdirs[i] && !reader.request(fi->subdirs[i])) {
+                    return; // window is full
+                }
+            }
+        }
+    };
+
+    open(std::make_shared<listing>(root));
+
+    while (!stack.empty()) {
+        frame &top = stack.back();
+
+        if (top.next == top.l->children.size()) {
+            stack.pop_back();
+            continue;
+        }
+
+        const size_t i = top.next++;
+        fn(top.l->children[i].entry);
+        count++;
+
+        if (top.subdirs[i]) {
+            listing_ptr sub = top.subdirs[i];
+            top.subdirs[i].reset();
+            open(sub); // invalidates top
+        }
+    }
+
+    return count;
+}
+
+}
+
+size_t walk(const file &root,
+            const std::function<void(const walk_entry &)> &fn,
+            const walk_options &opts) {
+
+    if (!root.is_directory()) {
+        return 0;
+    }
+
+    const walk_entry top{root, file_type::directory, 0};
+
+    if (opts.ordered) {
+        return walk_ordered(top, fn, opts);
+    }
+
+    return walk_unordered(top, fn, opts);
+}
+
+}
@@ -0,0 +1,50 @@
+#ifndef IRIS_WALK_H
+#define IRIS_WALK_H
+
+#include <fs.h>
+
+#include <functional>
+#include <limits>
+
+namespace fs {
+
+struct walk_entry {
+    fs::file  file;
+    file_type type;
+    size_t    depth;   // 1 for the children of the root
+};
+
+struct walk_options {
+    size_t nthreads = 0;      // 0: one per core
+    size_t max_depth = std::numeric_limits<size_t>::max();
+    bool   hidden = false;    // visit names starting with a dot
+    bool   follow_links = false;
+
+    // deliver the entries on the calling thread, in pre-order with the
+    // entries of each directory sorted by name; the directories are still
+    // read ahead on the worker threads
+    bool   ordered = false;
+
+    // called for every directory before it is descended into, false
+    // prunes it (the entry itself is still passed to the callback);
+    // may be called from any thread
+    std::function<bool(const walk_entry &)> descend;
+};
+
+/* Walks the tree below root, calling fn for every entry. Directories are
+ * read on a pool of threads: each worker descends depth-first into the
+ * directories it found itself and steals the oldest pending directory
+ * from the others when it runs out, so pending work stays in the order
+ * of the tree depth times the fan-out. Unless ordered, fn runs on the
+ * worker threads, concurrently and in no particular order.
+ *
+ * The first exception thrown by fn (or descend) stops the walk and is
+ * rethrown. Returns the number of entries passed to fn.
+ */
+size_t walk(const file &root,
+            const std::function<void(const walk_entry &)> &fn,
+            const walk_options &opts = walk_options());
+
+}
+
+#endif
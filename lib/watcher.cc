@@ -0,0 +1,316 @@
+#include <watcher.h>
+#include <catalog.h>
+
+#include <stdexcept>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+namespace iris {
+namespace data {
+
+static bool classify(const std::string &rel, store_watcher::kind &k) {
+    size_t sep = rel.find('/');
+    size_t last = rel.rfind('/');
+
+    if (sep == std::string::npos) {
+        k = store_watcher::kind::links;
+        return rel == "links.cfg";
+    } else if (sep == last) {
+        return false; // directly in monitors/ or subjects/
+    }
+
+    const std::string top = rel.substr(0, sep);
+    const std::string dir = rel.substr(sep + 1, last - sep - 1);
+    const std::string name = rel.substr(last + 1);
+
+    if (top == "monitors") {
+        if (name == dir + ".monitor") {
+            k = store_watcher::kind::monitor;
+        } else if (fs::fn_matcher("*.settings")(name)) {
+            k = store_watcher::kind::settings;
+        } else if (fs::fn_matcher("*.rgb2lms")(name)) {
+            k = store_watcher::kind::rgb2lms;
+        } else {
+            return false;
+        }
+    } else if (top == "subjects") {
+        if (name == dir + ".subject") {
+            k = store_watcher::kind::subject;
+        } else if (fs::fn_matcher("*.isoslant")(name)) {
+            k = store_watcher::kind::isoslant;
+        } else if (fs::fn_matcher("*.isodata")(name)) {
+            k = store_watcher::kind::isodata;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+size_t store_watcher::subscribe(callback cb) {
+    std::lock_guard<std::mutex> guard(sub_lock);
+    subs[next_id] = cb;
+    return next_id++;
+}
+
+void store_watcher::unsubscribe(size_t id) {
+    std::lock_guard<std::mutex> guard(sub_lock);
+    subs.erase(id);
+}
+
+void store_watcher::notify(const event &ev) {
+    std::vector<callback> cbs;
+    {
+        std::lock_guard<std::mutex> guard(sub_lock);
+        for (const auto &kv : subs) {
+            cbs.push_back(kv.second);
+        }
+    }
+
+    for (const callback &cb : cbs) {
+        cb(ev);
+    }
+}
+
+bool store_watcher::dispatch(const std::string &rel, bool removed) {
+    event ev;
+    if (!classify(rel, ev.kind)) {
+        return false;
+    }
+
+    ev.file = st.location().child(rel);
+    ev.removed = removed;
+
+    st.index().update(rel, removed);
+    notify(ev);
+
+    return true;
+}
+
+// a monitor or subject directory was removed or moved away, the files
+// in it are gone without events of their own; the event's file is the
+// directory
+void store_watcher::dispatch_dir_removal(const std::string &rel) {
+    const std::string top = rel.substr(0, rel.find('/'));
+
+    event ev;
+    ev.kind = top == "monitors" ? kind::monitor : kind::subject;
+    ev.file = st.location().child(rel);
+    ev.removed = true;
+
+    st.index().update(rel, true);
+    notify(ev);
+}
+
+void store_watcher::start() {
+    if (running) {
+        return;
+    }
+
+    running = true;
+    worker = std::thread([this]() {
+        while (running) {
+            poll(-1);
+        }
+    });
+}
+
+#ifdef __linux__
+
+static const uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                                   IN_DELETE | IN_CREATE | IN_ONLYDIR;
+
+bool store_watcher::supported() {
+    return true;
+}
+
+store_watcher::store_watcher(const store &store) : st(store), running(false) {
+    ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd < 0) {
+        throw std::runtime_error("store_watcher: inotify_init1 failed");
+    }
+
+    if (pipe2(wake, O_NONBLOCK | O_CLOEXEC) != 0) {
+        close(ifd);
+        throw std::runtime_error("store_watcher: could not create pipe");
+    }
+
+    watch_dir("", false);
+}
+
+store_watcher::~store_watcher() {
+    stop();
+    close(wake[0]);
+    close(wake[1]);
+    close(ifd);
+}
+
+void store_watcher::stop() {
+    if (!running) {
+        return;
+    }
+
+    running = false;
+    ssize_t res = write(wake[1], "x", 1);
+    (void) res; // non-blocking; if the pipe is full the thread wakes anyway
+
+    worker.join();
+}
+
+// watch rel and, for the root and monitors/ and subjects/, the levels
+// below; with announce, files already present are dispatched, they might
+// have been written before the watch was in place
+void store_watcher::watch_dir(const std::string &rel, bool announce) {
+    fs::file dir = st.location().child(rel);
+
+    int wd = inotify_add_watch(ifd, dir.path().c_str(), watch_mask);
+    if (wd < 0) {
+        return; // gone already, or not a directory
+    }
+
+    dirs[wd] = rel;
+
+    const int depth = rel.empty() ? 0 : (rel.find('/') == std::string::npos ? 1 : 2);
+
+    fs::file::dir_enum entries = dir.children("*");
+    for (fs::dir_iterator it = entries.begin(); it != entries.end(); ++it) {
+        const std::string n = it.name();
+        const std::string child = rel.empty() ? n : rel + "/" + n;
+
+        if (it.type() == fs::file_type::directory) {
+            if ((depth == 0 && (n == "monitors" || n == "subjects")) || depth == 1) {
+                watch_dir(child, announce);
+            }
+        } else if (announce) {
+            dispatch(child, false);
+        }
+    }
+}
+
+size_t store_watcher::poll(int timeout_ms) {
+    struct pollfd fds[2];
+    fds[0].fd = ifd;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake[0];
+    fds[1].events = POLLIN;
+
+    int res = ::poll(fds, 2, timeout_ms);
+    if (res <= 0) {
+        return 0;
+    }
+
+    if (fds[1].revents & POLLIN) {
+        char buf[64];
+        while (read(wake[0], buf, sizeof(buf)) > 0) { }
+    }
+
+    size_t delivered = 0;
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (true) {
+        ssize_t len = read(ifd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            break;
+        }
+
+        for (char *ptr = buffer; ptr < buffer + len;) {
+            const struct inotify_event *ev = reinterpret_cast<const struct inotify_event *>(ptr);
+            ptr += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                st.index().invalidate();
+                notify(event{kind::rescan, st.location(), false});
+                delivered++;
+                continue;
+            }
+
+            if (ev->mask & IN_IGNORED) {
+                dirs.erase(ev->wd);
+                continue;
+            }
+
+            auto iter = dirs.find(ev->wd);
+            if (iter == dirs.end() || ev->len == 0) {
+                continue;
+            }
+
+            const std::string name(ev->name);
+            if (name[0] == '.') {
+                continue; // temporary files of fs::file::write_all, ...
+            }
+
+            const std::string rel = iter->second.empty() ? name : iter->second + "/" + name;
+            const bool removed = (ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0;
+
+            if (ev->mask & IN_ISDIR) {
+                const bool top = iter->second.empty();
+                if (top && (name == "monitors" || name == "subjects")) {
+                    if (!removed) {
+                        watch_dir(rel, true);
+                    } else {
+                        st.index().invalidate();
+                        notify(event{kind::rescan, st.location(), false});
+                        delivered++;
+                    }
+                } else if (iter->second == "monitors" || iter->second == "subjects") {
+                    if (!removed) {
+                        watch_dir(rel, true);
+                    } else {
+                        dispatch_dir_removal(rel);
+                        delivered++;
+                    }
+                }
+                continue;
+            }
+
+            if (ev->mask & IN_CREATE) {
+                continue; // wait for the IN_CLOSE_WRITE
+            }
+
+            delivered += dispatch(rel, removed) ? 1 : 0;
+        }
+    }
+
+    return delivered;
+}
+
+#else
+
+bool store_watcher::supported() {
+    return false;
+}
+
+store_watcher::store_watcher(const store &store) : st(store), ifd(-1), running(false) {
+    wake[0] = wake[1] = -1;
+    throw std::runtime_error("store_watcher: not supported on this platform");
+}
+
+store_watcher::~store_watcher() {
+
+}
+
+void store_watcher::stop() {
+
+}
+
+void store_watcher::watch_dir(const std::string &rel, bool announce) {
+
+}
+
+size_t store_watcher::poll(int timeout_ms) {
+    return 0;
+}
+
+#endif
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef IRIS_WATCHER_H
+#define IRIS_WATCHER_H
+
+#include <data.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace iris {
+namespace data {
+
+/* Watches a store for files written by other processes (e.g. by
+ * iris-store import or iris-fitiso) via inotify, Linux only. Each
+ * change is applied to the store's catalog, then handed to the
+ * subscribers.
+ *
+ * Events are read either by a background thread (start()) or by
+ * calling poll() from an existing event loop, e.g. when fd() becomes
+ * readable; callbacks run on whichever thread reads the events.
+ */
+class store_watcher {
+public:
+    enum class kind {
+        links, monitor, settings, rgb2lms, subject, isoslant, isodata,
+        rescan  // events were lost, the catalog was invalidated
+    };
+
+    struct event {
+        enum kind kind;
+        fs::file  file;
+        bool      removed;
+    };
+
+    typedef std::function<void(const event &)> callback;
+
+    explicit store_watcher(const store &store);
+    ~store_watcher();
+
+    store_watcher(const store_watcher &) = delete;
+    store_watcher &operator=(const store_watcher &) = delete;
+
+    static bool supported();
+
+    size_t subscribe(callback cb);
+    void unsubscribe(size_t id);
+
+    // handle pending events, waiting up to timeout_ms (-1: until there
+    // are some); returns the number of events delivered. Not to be
+    // called while the background thread runs.
+    size_t poll(int timeout_ms = 0);
+
+    void start();
+    void stop();
+
+    int fd() const { return ifd; }
+
+private:
+    void watch_dir(const std::string &rel, bool announce);
+    bool dispatch(const std::string &rel, bool removed);
+    void dispatch_dir_removal(const std::string &rel);
+    void notify(const event &ev);
+
+private:
+    store st;
+
+    int ifd;
+    int wake[2];
+    std::map<int, std::string> dirs; // watch descriptor -> relative path
+
+    std::mutex sub_lock;
+    std::map<size_t, callback> subs;
+    size_t next_id = 0;
+
+    std::thread worker;
+    std::atomic<bool> running;
+};
+
+}
+}
+
+#endif
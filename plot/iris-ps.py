@@ -3,6 +3,7 @@
 from __future__ import print_function
 from __future__ import division
 
+import h5py as h5
 import numpy as np
 import matplotlib.pyplot as plt
 import sys
@@ -13,6 +14,32 @@ import csv
 import StringIO
 import os
 
+HDF5_SIGNATURE = b'\x89HDF\r\n\x1a\n'
+
+def load_isodata(path):
+    # isodata is HDF5 (stimulus, response datasets and the YAML metadata
+    # as attribute), or YAML with the samples as CSV in older files
+    with open(path, 'rb') as f:
+        is_hdf5 = f.read(len(HDF5_SIGNATURE)) == HDF5_SIGNATURE
+
+    if is_hdf5:
+        fd = h5.File(path, 'r')
+        meta = yaml.safe_load(fd.attrs['metadata'])
+        x = list(np.array(fd['stimulus'], dtype='f8'))
+        y = list(np.array(fd['response'], dtype='f8'))
+        fd.close()
+        return meta, x, y
+
+    f = open(path)
+    data = yaml.safe_load(f)
+    f.close()
+
+    raw = data['isodata']['data']
+    reader = csv.reader(StringIO.StringIO(raw), delimiter=',', quotechar='#')
+    next(reader) # ignore the header
+    x, y = zip(*[(float(r[0]), float(r[1])) for r in reader])
+    return data, x, y
+
 def main():
     parser = argparse.ArgumentParser(description='CI - Plot ISO fit')
     parser.add_argument('--freq', dest='freq', type=float, default=1.0)
@@ -32,9 +59,7 @@ def main():
         sys.stderr.write("No data\n")
         sys.exit(-1)
 
-    f = open(data_fn)
-    data = yaml.safe_load(f)
-    f.close()
+    data, x, y = load_isodata(data_fn)
 
     iso = None
     if os.path.exists(slant_fn):
@@ -42,11 +67,6 @@ def main():
         iso = yaml.safe_load(f)
         f.close()
 
-    raw = data['isodata']['data']
-    print(raw)
-    reader = csv.reader(StringIO.StringIO(raw), delimiter=',', quotechar='#')
-    next(reader) # ignore the header
-    x, y = zip(*[(float(r[0]), float(r[1])) for r in reader])
     print(x, y)
 
     plt.scatter(x, y,  color='dodgerblue', label='data')
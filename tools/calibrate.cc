@@ -1,5 +1,6 @@
 
 #include <h5x/File.hpp>
+#include <h5x/hydra/iris.hpp>
 
 #include <boost/program_options.hpp>
 
@@ -8,11 +9,17 @@
 #include <string>
 #include <bitset>
 #include <cmath>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <sstream>
 
 #include <fstream>
 #include <spectra.h>
 #include <rgb.h>
 #include <fit.h>
+#include <vmath.h>
 #include <dkl.h>
 #include <fs.h>
 #include <data.h>
@@ -72,11 +79,82 @@ std::vector<double> cmp_luminance(const h5x::File &fd, const iris::spectra &cf,
 
 }
 
+static void benchmark_fit(const std::vector<double> &x,
+                          const std::vector<double> &y,
+                          double weight_exp) {
+
+    std::cerr << "[I] vmath::exp_ax max relative error: " << iris::vmath::exp_ax_error();
+    std::cerr << " (bound 4e-16)" << std::endl;
+
+    std::cerr << "jacobian \t success \t evals \t jac evals \t time [ms]" << std::endl;
+
+    for (bool analytic : {true, false}) {
+        iris::rgb2sml_fitter fitter(x, y, weight_exp);
+        fitter.use_jacobian(analytic);
+
+        auto start = std::chrono::steady_clock::now();
+        bool res = fitter();
+        auto stop = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double, std::milli> elapsed = stop - start;
+
+        std::cerr << (analytic ? "analytic" : "numeric") << " \t " << res;
+        std::cerr << " \t " << fitter.evaluations() << " \t " << fitter.jacobian_evaluations();
+        std::cerr << " \t " << elapsed.count() << std::endl;
+    }
+}
+
+static bool multistart_fit(iris::rgb2sml_fitter &fitter,
+                           const std::vector<double> &x,
+                           const std::vector<double> &y,
+                           double weight_exp,
+                           size_t nstarts,
+                           size_t nthreads) {
+
+    iris::multistart ms([&]() {
+        return std::unique_ptr<iris::fitter>(new iris::rgb2sml_fitter(x, y, weight_exp));
+    });
+
+    const double *p0 = fitter.params();
+    std::vector<double> start(p0, p0 + fitter.num_parameter());
+
+    std::mt19937 rnd_gen(42);
+    auto starts = iris::multistart::perturbed(start, 1.0, nstarts, rnd_gen);
+
+    auto t_start = std::chrono::steady_clock::now();
+    iris::multistart_result res = ms(starts, nthreads);
+    auto t_stop = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = t_stop - t_start;
+
+    std::cerr << "[I] multi-start: " << res.converged << " of " << nstarts << " converged";
+    std::cerr << " in " << elapsed.count() << " ms" << std::endl;
+
+    if (res.converged == 0) {
+        return false;
+    }
+
+    std::vector<double> rs;
+    std::copy_if(res.residuals.cbegin(), res.residuals.cend(), std::back_inserter(rs),
+                 [](double r) { return !std::isnan(r); });
+    std::sort(rs.begin(), rs.end());
+
+    size_t hits = std::count_if(rs.cbegin(), rs.cend(), [&res](double r) {
+        return r <= res.residual * (1.0 + 1e-3);
+    });
+
+    std::cerr << "[I] residual best: " << res.residual << ", median: " << rs[rs.size() / 2];
+    std::cerr << ", worst: " << rs.back() << ", at best: " << hits << std::endl;
+
+    std::copy(res.params.cbegin(), res.params.cend(), fitter.params());
+    return true;
+}
+
 static void save_calibration_to_h5(h5x::File &fd,
                                    std::vector<double> &x,
                                    std::vector<double> &y,
                                    size_t nspec,
-                                   const iris::dkl::parameter & dklp) {
+                                   const iris::dkl::parameter & dklp,
+                                   const h5x::DataSetOptions &h5opts) {
     h5x::Group cag = fd.openGroup("rgb2sml", true);
 
     h5x::DataSet cai;
@@ -84,7 +162,7 @@ static void save_calibration_to_h5(h5x::File &fd,
     if (cag.hasData("cone-activations")) {
         cai = cag.openData("cone-activations");
     } else {
-        cai = cag.createData("cone-activations", h5x::TypeId::Float, cai_dims);
+        cai = cag.createData("cone-activations", h5x::data_type_to_h5_filetype(h5x::TypeId::Float), cai_dims, h5opts);
     }
 
     cai.setExtent(cai_dims);
@@ -114,10 +192,16 @@ int main(int argc, char **argv) {
     std::string cones;
     double weight_exp = 1.1;
     bool check_lum = false;
+    bool bench_fit = false;
+    bool use_cache = true;
+    size_t nstarts = 1;
+    size_t nthreads = 0;
     float dsp_width = -1;
     float dsp_height = -1;
 
     bool only_stdout = false;
+    std::string compression = "shuffle,deflate=4";
+    std::string h5_access;
 
     po::options_description opts("calibration tool");
     opts.add_options()
@@ -125,10 +209,16 @@ int main(int argc, char **argv) {
             ("cone-fundamentals,c", po::value<std::string>(&cones))
             ("weight-exponent,w", po::value<double>(&weight_exp))
             ("check-luminance", po::value<bool>(&check_lum))
+            ("starts", po::value<size_t>(&nstarts), "number of multi-start fits [default=1]")
+            ("threads", po::value<size_t>(&nthreads), "threads for multi-start fits [default=all cores]")
+            ("cache", po::value<bool>(&use_cache), "reuse fit results cached in the store [default=true]")
+            ("benchmark-fit", po::value<bool>(&bench_fit), "compare analytic and numeric jacobian fits")
             ("width,W", po::value<float>(&dsp_width))
             ("height,H", po::value<float>(&dsp_height))
             ("input", po::value<std::string>(&input)->required())
-            ("stdout", po::value<bool>(&only_stdout));
+            ("stdout", po::value<bool>(&only_stdout))
+            ("compression", po::value<std::string>(&compression), "HDF5 filter chain of the .cac file, or none [default=shuffle,deflate=4]")
+            ("h5-access", po::value<std::string>(&h5_access), "HDF5 access options of the input, e.g. chunk-cache=16M,mdc=4M:64M or core");
 
     po::positional_options_description pos;
     pos.add("input", 1);
@@ -149,12 +239,22 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    h5x::DataSetOptions h5opts;
+    h5x::FileOptions h5access;
+    try {
+        h5opts = h5x::DataSetOptions::parse(compression);
+        h5access = h5x::FileOptions::parse(h5_access);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "[E] " << e.what() << std::endl;
+        return 1;
+    }
+
     if (dsp_height < 0 || dsp_width < 0) {
         std::cerr << "[E] Need height and width paramters";
         return 2;
     }
 
-    h5x::File fd = h5x::File::open(input, "r+");
+    h5x::File fd = h5x::File::open(input, "r+", h5access);
 
     if (!fd.hasData("spectra") || !fd.hasData("patches")) {
         std::cerr << "File missing spectra or patches" << std::endl;
@@ -163,19 +263,27 @@ int main(int argc, char **argv) {
 
 
     h5x::DataSet sp = fd.openData("spectra");
-    h5x::DataSet ps = fd.openData("patches");
 
-    h5x::NDSize sp_size = sp.size();
-    h5x::NDSize ps_size = ps.size();
+    uint16_t wl_start = 380;
+    uint16_t wl_step = 4;
+    sp.getAttr("wl_start", wl_start);
+    sp.getAttr("wl_step", wl_step);
 
-    spectra spec(sp_size[0], sp_size[1], 380, 4);
+    spectra spec(0, 0, wl_start, wl_step);
+    fd.getData("spectra", spec);
 
-    sp.read(h5x::TypeId::Float, sp_size, spec.data());
+    std::unique_ptr<data::store> store;
+    try {
+        store.reset(new data::store(data::store::default_store()));
+    } catch (const std::exception &e) {
+        if (cones.empty()) {
+            throw;
+        }
+    }
 
     fs::file cff;
     if (cones.empty()) {
-        iris::data::store store = iris::data::store::default_store();
-        cff = store.cone_fundamentals(4);
+        cff = store->cone_fundamentals(4);
     } else {
         cff = fs::file(cones);
     }
@@ -184,8 +292,8 @@ int main(int argc, char **argv) {
 
     spectra cf = iris::spectra::from_csv(cff);
 
-    std::vector<iris::rgb> stim(ps_size[0]);
-    ps.read(h5x::TypeId::Float, ps_size, stim.data());
+    std::vector<iris::rgb> stim;
+    fd.getData("patches", stim);
 
     std::vector<double> y;
     std::vector<double> x;
@@ -221,10 +329,46 @@ int main(int argc, char **argv) {
     }
 
 
-    rgb2sml_fitter fitter(x, y, weight_exp);
-    fitter();
+    if (bench_fit) {
+        benchmark_fit(x, y, weight_exp);
+    }
+
+    // the fit only depends on (x, y) and the options; cache entries
+    // hold the 15 parameters at full precision
+    std::string key = digest().value(IRIS_FIT_VERSION).update(x).update(y)
+            .value(weight_exp).value(nstarts).hex();
 
-    dkl::parameter dklp = fitter.rgb2sml();
+    dkl::parameter dklp;
+    std::string entry;
+
+    if (use_cache && store && store->load_cached("rgb2sml", key, entry)) {
+        std::cerr << "[I] cached fit [" << key << "]" << std::endl;
+        std::stringstream in(entry);
+        for (double &v : dklp.A_zero) { in >> v; }
+        for (double &v : dklp.A) { in >> v; }
+        for (double &v : dklp.gamma) { in >> v; }
+
+        if (!in) {
+            throw std::runtime_error("corrupt cache entry: " + key);
+        }
+
+    } else {
+        rgb2sml_fitter fitter(x, y, weight_exp);
+        if (nstarts < 2 || !multistart_fit(fitter, x, y, weight_exp, nstarts, nthreads)) {
+            fitter();
+        }
+
+        dklp = fitter.rgb2sml();
+
+        if (use_cache && store) {
+            std::stringstream out;
+            out.precision(std::numeric_limits<double>::max_digits10);
+            for (double v : dklp.A_zero) { out << v << " "; }
+            for (double v : dklp.A) { out << v << " "; }
+            for (double v : dklp.gamma) { out << v << " "; }
+            store->store_cached("rgb2sml", key, out.str());
+        }
+    }
 
     std::string tstamp = iris::make_timestamp();
     data::rgb2lms rgb2lms(tstamp);
@@ -264,7 +408,7 @@ int main(int argc, char **argv) {
     fd.close();
 
     h5x::File caf = h5x::File::open(tstamp + ".cac", "w+");
-    save_calibration_to_h5(caf, x, y, nspec, dklp);
+    save_calibration_to_h5(caf, x, y, nspec, dklp, h5opts);
     caf.close();
 
     return 0;
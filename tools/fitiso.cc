@@ -10,10 +10,62 @@
 #include <random>
 #include <numeric>
 #include <algorithm>
+#include <chrono>
 #include <csv.h>
 #include <fit.h>
 #include <data.h>
 #include <fs.h>
+#include <isofit.h>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+// the store, if there is one, for the fit result cache
+static std::unique_ptr<iris::data::store> open_cache() {
+    try {
+        return std::unique_ptr<iris::data::store>(new iris::data::store(iris::data::store::default_store()));
+    } catch (const std::exception &e) {
+        std::cerr << "[W] no store, not caching fit results: " << e.what() << std::endl;
+    }
+
+    return nullptr;
+}
+
+static int fit_all(const iris::isofit_options &opts, size_t nthreads) {
+    iris::data::store store = iris::data::store::default_store();
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<iris::batch_entry> entries = iris::batch_fit(store, opts, nthreads);
+    auto stop = std::chrono::steady_clock::now();
+    std::chrono::duration<double, std::milli> elapsed = stop - start;
+
+    size_t failed = 0;
+
+    std::cout << "file \t subject \t dl \t phi \t ok \t parse [ms] \t fit [ms] \t write [ms]" << std::endl;
+    for (const iris::batch_entry &e : entries) {
+        std::cout << e.input.name() << " \t " << e.iso.subject << " \t ";
+        if (e.success) {
+            std::cout << e.iso.dl << " \t " << e.iso.phi << " \t ";
+        } else {
+            std::cout << "- \t - \t ";
+            failed++;
+        }
+
+        std::cout << e.success << " \t " << std::fixed << std::setprecision(3);
+        std::cout << e.t_parse << " \t " << e.t_fit << " \t " << e.t_write << std::endl;
+        std::cout.unsetf(std::ios_base::floatfield);
+        std::cout << std::setprecision(6);
+
+        if (!e.error.empty()) {
+            std::cerr << "[W] " << e.input.path() << ": " << e.error << std::endl;
+        }
+    }
+
+    std::cerr << "[I] fitted " << entries.size() - failed << " of " << entries.size();
+    std::cerr << " in " << elapsed.count() << " ms" << std::endl;
+
+    return failed == 0 ? 0 : -1;
+}
 
 int main(int argc, char **argv) {
 
@@ -23,13 +75,24 @@ int main(int argc, char **argv) {
     bool fit_freq = false;
     bool only_stdout = false;
     double offset = -1.0;
+    size_t nboot = 0;
+    double level = 0.95;
+    bool jackknife = false;
+    size_t nthreads = 0;
+    bool use_cache = true;
 
     po::options_description opts("calibration tool");
     opts.add_options()
             ("help", "produce help message")
             ("fit-frequency", po::value<bool>(&fit_freq), "also fit sin frequency [default=false]")
             ("offset", po::value<double>(&offset), "fix the offset [default=fit it]")
-            ("file", po::value<std::string>(&infile_path)->required())
+            ("bootstrap", po::value<size_t>(&nboot), "bootstrap refits for confidence intervals [default=0]")
+            ("confidence", po::value<double>(&level), "confidence level of the intervals [default=0.95]")
+            ("jackknife", po::value<bool>(&jackknife), "report jackknife standard errors [default=false]")
+            ("threads", po::value<size_t>(&nthreads), "threads for resampling, or for the files with --all [default=all cores]")
+            ("cache", po::value<bool>(&use_cache), "reuse fit results cached in the store [default=true]")
+            ("all", "fit all isodata files in the store")
+            ("file", po::value<std::string>(&infile_path))
             ("stdout", po::value<bool>(&only_stdout));
 
     po::positional_options_description pos;
@@ -50,43 +113,104 @@ int main(int argc, char **argv) {
         return 0;
     }
 
+    if (!(level > 0.0 && level < 1.0)) {
+        std::cerr << "[E] --confidence must be between 0 and 1, e.g. 0.95" << std::endl;
+        return 1;
+    }
+
+    iris::isofit_options iso_opts;
+    iso_opts.fit_frequency = fit_freq;
+    iso_opts.offset = offset;
+    iso_opts.bootstrap = nboot;
+    iso_opts.level = level;
+    iso_opts.jackknife = jackknife;
+    iso_opts.threads = nthreads;
+
+    if (vm.count("all") > 0) {
+        if (vm.count("jackknife") > 0 || vm.count("cache") > 0) {
+            std::cerr << "[E] --jackknife and --cache do not work with --all" << std::endl;
+            return 1;
+        }
+
+        return fit_all(iso_opts, nthreads);
+    }
+
+    if (infile_path.empty()) {
+        std::cerr << "Need input file (or --all)" << std::endl;
+        return 1;
+    }
+
     fs::file fd(infile_path);
     std::string raw = fd.read_all();
-    iris::data::isodata input = iris::data::store::yaml2isodata(raw);
 
-    std::vector<double> x(input.samples.size());
-    std::vector<double> y(input.samples.size());
-    std::transform(input.samples.cbegin(), input.samples.cend(), x.begin(),
-                   [](const iris::data::isodata::sample &s) {
-                       return s.stimulus;
-                   });
+    // cache entry: "A phi offset frequency" line, then the isoslant
+    std::unique_ptr<iris::data::store> cache;
+    std::string key;
+    if (use_cache && (cache = open_cache())) {
+        key = iris::digest().value(IRIS_FIT_VERSION).update(raw)
+                .value(fit_freq).value(offset)
+                .value(nboot).value(level).value(jackknife).hex();
+
+        std::string entry;
+        if (cache->load_cached("isoslant", key, entry)) {
+            size_t eol = entry.find('\n');
+            std::cerr << "[I] cached fit [" << key << "]" << std::endl;
+            std::cerr << "success: 1" << std::endl;
+            std::cout << entry.substr(0, eol) << std::endl;
+
+            std::string outdata = entry.substr(eol + 1);
+            iris::data::isoslant iso = iris::data::store::yaml2isoslant(outdata);
+            if (only_stdout) {
+                std::cout << outdata << std::endl;
+            } else {
+                fs::file outfile(iso.identifier() + ".isoslant");
+                outfile.write_all(outdata);
+            }
+
+            return 0;
+        }
+    }
+
+    iris::data::isodata input = iris::data::store::load_isodata(fd);
 
-    std::transform(input.samples.cbegin(), input.samples.cend(), y.begin(),
-                   [](const iris::data::isodata::sample &s) {
-                       return s.response;
-                   });
+    iris::data::isoslant iso;
+    iris::isofit_report report;
+    bool res = iris::fit_isoslant(input, iso_opts, iso, &report);
 
-    iris::sin_fitter fitter(x, y, fit_freq, offset);
-    bool res = fitter();
+    std::stringstream summary;
+    summary << report.amplitude << " " << report.phase << " ";
+    summary << report.offset << (offset < 0 ? " " : "* ");
+    summary << report.frequency << (fit_freq ? " " : "* ");
 
     std::cerr << "success: " << res << std::endl;
-    std::cout << fitter.amplitude() << " " << fitter.phase() << " ";
-    std::cout << fitter.offset() << (offset < 0 ? " " : "* ");
-    std::cout << fitter.frequency() << (fit_freq ? " " : "* ");
-    std::cout << std::endl;
+    std::cout << summary.str() << std::endl;
 
     if (res) {
-        std::string tstamp = iris::make_timestamp();
-        iris::data::isoslant iso(input.identifier());
-        iso.dl = fitter.amplitude();
-        iso.phi = fitter.phase();
-        iso.subject = input.subject;
-        iso.display = input.display;
-        iso.rgb2lms = input.rgb2lms;
+        if (nboot > 0) {
+            std::cerr << "[I] bootstrap: " << report.boot_refits << " refits, " << report.boot_failed;
+            std::cerr << " failed, " << report.t_boot << " ms" << std::endl;
+        }
+
+        if (iso.ci_level > 0.0) {
+            std::cerr << "[I] " << level * 100 << "% CI dl: [" << iso.dl_ci.lower << ", " << iso.dl_ci.upper << "]";
+            std::cerr << " phi: [" << iso.phi_ci.lower << ", " << iso.phi_ci.upper << "]" << std::endl;
+        }
+
+        if (jackknife) {
+            std::cerr << "[I] jackknife SE dl: " << report.dl_se;
+            std::cerr << " phi: " << report.phi_se;
+            std::cerr << " (" << report.jack_failed << " failed)" << std::endl;
+        }
+
         std::cerr << "[I] subject: " << iso.subject << std::endl;
         std::cerr << "[I] rgb2lms: " << iso.rgb2lms << std::endl;
 
         std::string outdata = iris::data::store::isoslant2yaml(iso);
+
+        if (cache) {
+            cache->store_cached("isoslant", key, summary.str() + "\n" + outdata);
+        }
+
         if (only_stdout) {
             std::cout << outdata << std::endl;
         } else {
@@ -0,0 +1,327 @@
+
+#include <h5x/File.hpp>
+#include <h5x/Appender.hpp>
+#include <h5x/Selection.hpp>
+
+#include <fs.h>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+// Write throughput against file size of the HDF5 filter chains, for
+// spectra as iris-measure writes them: appended record by record and
+// flushed every n records. The other write modes compare the selections
+// used for this, from one hyperslab per record to one per flush.
+
+static std::vector<float> synthetic_spectra(size_t nspec, size_t nwl) {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> peak(0.0f, 1.0f);
+    std::normal_distribution<float> noise(0.0f, 2e-6f);
+
+    std::vector<float> data(nspec * nwl);
+
+    // a mix of three primaries and a noise floor, like a screen measured
+    // through the PR-655 at 380:4:780 nm
+    const float centers[3] = {0.80f, 0.42f, 0.18f};
+    const float widths[3] = {0.05f, 0.09f, 0.04f};
+
+    for (size_t i = 0; i < nspec; i++) {
+        const float gains[3] = {peak(rng), peak(rng), peak(rng)};
+        for (size_t k = 0; k < nwl; k++) {
+            const float x = static_cast<float>(k) / static_cast<float>(nwl);
+            float v = 0.0f;
+            for (size_t c = 0; c < 3; c++) {
+                const float d = (x - centers[c]) / widths[c];
+                v += 4e-3f * gains[c] * std::exp(-0.5f * d * d);
+            }
+            data[i * nwl + k] = std::max(0.0f, v + noise(rng));
+        }
+    }
+
+    return data;
+}
+
+// how the records reach the file
+enum class write_mode {
+    append,   // h5x::Appender, extending the DataSet on every flush
+    row,      // into a DataSet of the final size, one hyperslab per record
+    block,    // same, one hyperslab of all the records of a flush
+    scatter   // same, flush j writes every nflush-th record from j on, as
+              // one multi-block selection
+};
+
+static write_mode parse_mode(const std::string &str) {
+    if (str == "append") {
+        return write_mode::append;
+    } else if (str == "row") {
+        return write_mode::row;
+    } else if (str == "block") {
+        return write_mode::block;
+    } else if (str == "scatter") {
+        return write_mode::scatter;
+    }
+
+    throw std::invalid_argument("unknown write mode: " + str);
+}
+
+struct result {
+    std::string mode;
+    std::string chain;
+    double      ms;
+    size_t      bytes;
+    double      max_error;
+};
+
+static void write_spectra(h5x::File &fd, write_mode mode, const h5x::DataSetOptions &options,
+                          const std::vector<float> &spectra, size_t nwl, size_t flush_every) {
+    const size_t nspec = spectra.size() / nwl;
+
+    if (mode == write_mode::append) {
+        h5x::Appender app(fd, "spectra", h5x::TypeId::Float, {nwl}, 0, options);
+
+        for (size_t i = 0; i < nspec; i += flush_every) {
+            const size_t n = std::min(flush_every, nspec - i);
+            app.append(spectra.data() + i * nwl, n);
+            app.flush();
+        }
+
+        return;
+    }
+
+    h5x::DataSet ds = fd.createData("spectra", h5x::data_type_to_h5_filetype(h5x::TypeId::Float),
+                                    {nspec, nwl}, options);
+
+    const size_t nflush = (nspec + flush_every - 1) / flush_every;
+    std::vector<float> packed;
+    std::vector<h5x::ndsize_t> rows;
+
+    for (size_t j = 0; j < nflush; j++) {
+        const size_t first = j * flush_every;
+        const size_t n = std::min(flush_every, nspec - first);
+
+        if (mode == write_mode::row) {
+            for (size_t i = first; i < first + n; i++) {
+                ds.writeRows(h5x::TypeId::Float, i, 1, spectra.data() + i * nwl);
+            }
+        } else if (mode == write_mode::block) {
+            ds.writeRows(h5x::TypeId::Float, first, n, spectra.data() + first * nwl);
+        } else {
+            rows.clear();
+            packed.clear();
+            for (size_t i = j; i < nspec; i += nflush) {
+                rows.push_back(i);
+                packed.insert(packed.end(), spectra.begin() + i * nwl, spectra.begin() + (i + 1) * nwl);
+            }
+            ds.writeRows(h5x::TypeId::Float, rows, packed.data());
+        }
+
+        fd.flush();
+    }
+}
+
+// largest difference of the odd records, read through a strided
+// hyperslab, and of every third, read as a set of rows, to the input
+static double scattered_error(const h5x::DataSet &ds, const std::vector<float> &spectra, size_t nwl) {
+    const size_t nspec = spectra.size() / nwl;
+    double max_error = 0.0;
+
+    const size_t nodd = nspec / 2;
+    if (nodd > 0) {
+        h5x::Selection fileSel(ds.getSpace());
+        const size_t one = 1;
+        fileSel.select({nodd, one}, {1, 0}, {2, 1}, {one, nwl});
+
+        std::vector<float> odd(fileSel.elements());
+        h5x::Selection memSel(h5x::DataSpace::create({nodd, nwl}, false));
+        ds.read(h5x::TypeId::Float, odd.data(), fileSel, memSel);
+
+        for (size_t i = 0; i < nodd; i++) {
+            for (size_t k = 0; k < nwl; k++) {
+                const double d = odd[i * nwl + k] - spectra[(2 * i + 1) * nwl + k];
+                max_error = std::max(max_error, std::fabs(d));
+            }
+        }
+    }
+
+    std::vector<h5x::ndsize_t> rows;
+    for (size_t i = 0; i < nspec; i += 3) {
+        rows.push_back(i);
+    }
+
+    std::vector<float> third(rows.size() * nwl);
+    ds.readRows(h5x::TypeId::Float, rows, third.data());
+
+    for (size_t i = 0; i < rows.size(); i++) {
+        for (size_t k = 0; k < nwl; k++) {
+            const double d = third[i * nwl + k] - spectra[rows[i] * nwl + k];
+            max_error = std::max(max_error, std::fabs(d));
+        }
+    }
+
+    return max_error;
+}
+
+static result run(const std::string &mode, const std::string &chain, const std::string &path,
+                  const std::vector<float> &spectra, size_t nwl, size_t flush_every,
+                  const h5x::FileOptions &access) {
+    const write_mode wm = parse_mode(mode);
+    const h5x::DataSetOptions options = h5x::DataSetOptions::parse(chain);
+
+    auto start = std::chrono::steady_clock::now();
+    {
+        h5x::File fd = h5x::File::open(path, "w", access);
+        write_spectra(fd, wm, options, spectra, nwl, flush_every);
+        fd.close();
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    std::vector<float> back(spectra.size());
+    double max_error = 0.0;
+    {
+        h5x::File fd = h5x::File::open(path, "r", access);
+        h5x::DataSet ds = fd.openData("spectra");
+        ds.read(h5x::TypeId::Float, ds.size(), back.data());
+        max_error = scattered_error(ds, spectra, nwl);
+    }
+
+    for (size_t i = 0; i < spectra.size(); i++) {
+        max_error = std::max(max_error, std::fabs(static_cast<double>(back[i]) - spectra[i]));
+    }
+
+    result r;
+    r.mode = mode;
+    r.chain = chain;
+    r.ms = std::chrono::duration<double, std::milli>(stop - start).count();
+    struct stat st;
+    r.bytes = stat(path.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+    r.max_error = max_error;
+    return r;
+}
+
+int main(int argc, char **argv) {
+    namespace po = boost::program_options;
+
+    std::string input;
+    std::string output = "h5bench.h5";
+    std::vector<std::string> chains;
+    std::vector<std::string> modes;
+    size_t nspec = 2000;
+    size_t nwl = 101;
+    size_t flush_every = 1;
+    std::string h5_access;
+
+    po::options_description opts("HDF5 filter benchmark");
+    opts.add_options()
+            ("help", "produce help message")
+            ("chain,c", po::value<std::vector<std::string>>(&chains), "filter chain to test, repeatable [default: a selection]")
+            ("spectra,n", po::value<size_t>(&nspec), "number of synthetic spectra [default=2000]")
+            ("wavelengths", po::value<size_t>(&nwl), "samples per synthetic spectrum [default=101]")
+            ("write,w", po::value<std::vector<std::string>>(&modes), "how records are written, repeatable: append, row, block or scatter [default=append]")
+            ("flush-every", po::value<size_t>(&flush_every), "records per append and flush [default=1]")
+            ("output,o", po::value<std::string>(&output), "scratch file [default=h5bench.h5]")
+            ("input", po::value<std::string>(&input), "measurement file whose spectra to use")
+            ("h5-access", po::value<std::string>(&h5_access), "HDF5 access options, e.g. chunk-cache=16M,page-buffer=4M or core");
+
+    po::positional_options_description pos;
+    pos.add("input", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(opts).positional(pos).run(), vm);
+        po::notify(vm);
+    } catch (const std::exception &e) {
+        std::cerr << "Error while parsing commad line options: " << std::endl;
+        std::cerr << "\t" << e.what() << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help") > 0) {
+        std::cout << opts << std::endl;
+        return 0;
+    }
+
+    if (chains.empty()) {
+        chains = {"none", "deflate=1", "shuffle,deflate=1", "shuffle,deflate=4",
+                  "shuffle,deflate=9", "scaleoffset=6,deflate=4", "shuffle,deflate=4,fletcher32"};
+    }
+
+    if (modes.empty()) {
+        modes = {"append"};
+    }
+
+    flush_every = std::max<size_t>(1, flush_every);
+
+    h5x::FileOptions access;
+    try {
+        access = h5x::FileOptions::parse(h5_access);
+        if (access.core && !access.coreBackingStore) {
+            throw std::invalid_argument("memory: the file has to be read back");
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "[E] " << e.what() << std::endl;
+        return 1;
+    }
+
+    std::vector<float> spectra;
+    if (!input.empty()) {
+        h5x::File fd = h5x::File::open(input, "r", access);
+        h5x::DataSet ds = fd.openData("spectra");
+        h5x::NDSize size = ds.size();
+        if (size.size() != 2) {
+            std::cerr << "[E] " << input << ": spectra is not two dimensional" << std::endl;
+            return 1;
+        }
+        nwl = size[1];
+        spectra.resize(size.nelms());
+        ds.read(h5x::TypeId::Float, size, spectra.data());
+    } else {
+        spectra = synthetic_spectra(nspec, nwl);
+    }
+
+    const size_t raw = spectra.size() * sizeof(float);
+    std::cout << "[I] " << spectra.size() / nwl << " spectra × " << nwl << " floats, ";
+    std::cout << raw / 1024 << " KiB raw, flush every " << flush_every;
+    if (!h5_access.empty()) {
+        std::cout << ", " << h5_access;
+    }
+    std::cout << std::endl;
+
+    std::cout << std::left << std::setw(9) << "write" << std::setw(32) << "chain";
+    std::cout << std::right << std::setw(10) << "ms" << std::setw(10) << "MB/s";
+    std::cout << std::setw(10) << "KiB" << std::setw(8) << "ratio";
+    std::cout << std::setw(12) << "max error" << std::endl;
+
+    for (const std::string &mode : modes) {
+        for (const std::string &chain : chains) {
+            result r;
+            try {
+                r = run(mode, chain, output, spectra, nwl, flush_every, access);
+            } catch (const std::exception &e) {
+                std::cerr << "[E] " << mode << " " << chain << ": " << e.what() << std::endl;
+                continue;
+            }
+
+            std::cout << std::left << std::setw(9) << r.mode << std::setw(32) << r.chain;
+            std::cout << std::right << std::fixed;
+            std::cout << std::setw(10) << std::setprecision(1) << r.ms;
+            std::cout << std::setw(10) << std::setprecision(1) << (raw / 1e6) / (r.ms / 1e3);
+            std::cout << std::setw(10) << r.bytes / 1024;
+            std::cout << std::setw(8) << std::setprecision(2) << static_cast<double>(raw) / r.bytes;
+            std::cout << std::setw(12) << std::scientific << std::setprecision(1) << r.max_error;
+            std::cout << std::defaultfloat << std::endl;
+        }
+    }
+
+    fs::file(output).remove();
+    return 0;
+}
@@ -54,6 +54,25 @@ public:
         return resp;
     }
 
+    // time of each response, in s since the window opened
+    const std::vector<double>& response_times() const {
+        return resp_time;
+    }
+
+    // stop as soon as the running fit has amplitude and phase standard
+    // errors at or below the limits; only checked at the end of a block
+    // of `block` trials and after at least `min_trials` trials
+    void early_stop(double dl_se, double phi_se, size_t block, size_t min_trials) {
+        stop_dl_se = dl_se;
+        stop_phi_se = phi_se;
+        stop_block = std::max<size_t>(block, 1);
+        stop_min_trials = min_trials;
+    }
+
+    const iris::sin_estimator &estimate() const {
+        return estimator;
+    }
+
     void update_label();
 
 private:
@@ -80,6 +99,13 @@ private:
 
     bool completed;
     std::vector<double> resp;
+    std::vector<double> resp_time;
+
+    iris::sin_estimator estimator;
+    double stop_dl_se = 0.0;
+    double stop_phi_se = 0.0;
+    size_t stop_block = 1;
+    size_t stop_min_trials = 0;
 };
 
 flicker_wnd::flicker_wnd(const iris::data::rgb2lms &rgb2lms, const std::vector<double> &stimuli, int refresh)
@@ -118,6 +144,7 @@ flicker_wnd::flicker_wnd(const iris::data::rgb2lms &rgb2lms, const std::vector<d
     glfwSetTime(0.0);
 
     resp.resize(phi.size());
+    resp_time.resize(phi.size());
 
     fg_angle(phi[stim_index]);
 
@@ -194,13 +221,34 @@ void flicker_wnd::key_event(int key, int scancode, int action, int mods) {
         const double idx = stim_index++;
 
         resp[idx] = phi_adjusted;
+        resp_time[idx] = glfwGetTime();
+
+        std::cerr << phi[idx] << ", " << phi_adjusted;
 
-        std::cerr << phi[idx] << ", " << phi_adjusted << std::endl;
+        estimator.add(phi[idx], phi_adjusted);
+        if (estimator.valid()) {
+            std::cerr << " [dl: " << estimator.amplitude() << " ± " << estimator.amplitude_se();
+            std::cerr << ", phi: " << estimator.phase() << " ± " << estimator.phase_se() << "]";
+        }
+        std::cerr << std::endl;
 
         //reset reference point
         dkl.reference_gray(iris::rgb::gray(gray_level));
 
-        if (stim_index < phi.size()) {
+        const bool stop_now = (stop_dl_se > 0.0 || stop_phi_se > 0.0) &&
+                              stim_index % stop_block == 0 &&
+                              stim_index >= stop_min_trials &&
+                              estimator.converged(stop_dl_se > 0.0 ? stop_dl_se : HUGE_VAL,
+                                                  stop_phi_se > 0.0 ? stop_phi_se : HUGE_VAL);
+
+        if (stop_now) {
+            std::cerr << "[I] isoslant determined after " << stim_index << " of ";
+            std::cerr << phi.size() << " trials" << std::endl;
+            resp.resize(stim_index);
+            resp_time.resize(stim_index);
+            completed = true;
+            should_close(true);
+        } else if (stim_index < phi.size()) {
             fg_angle(phi[stim_index]);
         } else {
             completed = true;
@@ -234,6 +282,9 @@ int main(int argc, char **argv) {
         size_t R = 4;
         double contrast = 0.16;
         bool use_stdout = false;
+        double stop_dl_se = 0.0;
+        double stop_phi_se = 0.0;
+        size_t min_reps = 2;
         std::string sid;
 
         po::options_description opts("colortilt experiment");
@@ -243,6 +294,9 @@ int main(int argc, char **argv) {
                 ("repetition,r", po::value<size_t>(&R), "number of repetitions [default=4]")
                 ("contrast,c", po::value<double>(&contrast)->required())
                 ("stdout", po::value<bool>(&use_stdout))
+                ("stop-dl-se", po::value<double>(&stop_dl_se), "stop once the std. error of dl is below [default=0, off]")
+                ("stop-phi-se", po::value<double>(&stop_phi_se), "stop once the std. error of phi (rad) is below [default=0, off]")
+                ("min-repetitions", po::value<size_t>(&min_reps), "repetitions before stopping early [default=2]")
                 ("subject,S", po::value<std::string>(&sid)->required());
 
         po::positional_options_description pos;
@@ -298,6 +352,7 @@ int main(int argc, char **argv) {
         std::cerr << " nf: " << refresh << " (" << rk << ")" << std::endl;
 
         flicker_wnd wnd(rgb2lms, stim, refresh);
+        wnd.early_stop(stop_dl_se, stop_phi_se, N, std::min(min_reps, R) * N);
 
         glEnable(GL_BLEND);
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -314,6 +369,7 @@ int main(int argc, char **argv) {
 
         if (wnd.success()) {
             const std::vector<double> y = wnd.response();
+            const std::vector<double> &t = wnd.response_times();
 
             std::string tstamp = iris::make_timestamp();
             iris::data::isodata iso(iris::make_timestamp());
@@ -325,15 +381,15 @@ int main(int argc, char **argv) {
                 iso.samples[i].response = static_cast<float>(y[i]);
             }
 
+            iso.timestamps.assign(t.begin(), t.end());
             iso.display = display;
             iso.rgb2lms = rgb2lms.identifier();
 
-            std::string outstr = store.isodata2yaml(iso);
             if (use_stdout) {
-                std::cout << outstr << std::endl;
+                std::cout << store.isodata2yaml(iso) << std::endl;
             } else {
                 fs::file outfile(iso.identifier() + ".isodata");
-                outfile.write_all(outstr);
+                iris::data::store::save_isodata(iso, outfile);
             }
         }
 
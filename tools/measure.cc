@@ -1,5 +1,8 @@
 
 #include <h5x/File.hpp>
+#include <h5x/Appender.hpp>
+#include <h5x/AsyncWriter.hpp>
+#include <h5x/hydra/iris.hpp>
 
 #include <pr655.h>
 
@@ -176,11 +179,143 @@ static void check_gl_error(const std::string &prefix = "") {
     }
 }
 
+// Writes the measurements to the HDF5 file as they are taken, so that an
+// interrupted session keeps everything up to the last flush. Records are
+// packed in memory and handed, one batch per flush, to a writer thread
+// that appends them with one hyperslab per dataset; the measurement loop
+// never waits for the disk. All HDF5 calls happen on the writer thread.
+class spectra_recorder {
+public:
+    spectra_recorder(const std::string &path, size_t flush_every, const h5x::DataSetOptions &options)
+            : options(options), flush_every(std::max<size_t>(1, flush_every)), nwl(0), pending(0), recorded(0),
+              writer(h5x::File::open(path, "w"), 64) {
+
+        writer.submit([this](h5x::File &fd) {
+            luminance = h5x::Appender(fd, "luminance", h5x::TypeId::Float, {}, 0, this->options);
+            patches = h5x::Appender(fd, "patches", h5x::TypeId::Float, {static_cast<size_t>(3)}, 0, this->options);
+        });
+    }
+
+    void describe(const iris::data::display &display, float gray_level, device::pr655 &meter) {
+        const std::string model = meter.model_number();
+        const std::string serial = meter.serial_number();
+
+        writer.submit([display, gray_level, model, serial](h5x::File &fd) {
+            fd.setAttr("display.monitor", display.monitor_id);
+            fd.setAttr("display.link", display.link_id);
+            fd.setAttr("display.settings", display.settings_id);
+            fd.setAttr("display.gfx", display.gfx);
+            fd.setAttr("mode.height", display.mode.height);
+            fd.setAttr("mode.width", display.mode.width);
+            fd.setAttr("mode.refresh", display.mode.refresh);
+            fd.setAttr("mode.depth.r", display.mode.r);
+            fd.setAttr("mode.depth.g", display.mode.g);
+            fd.setAttr("mode.depth.b", display.mode.b);
+            fd.setAttr("gray-level", gray_level);
+            fd.setAttr("meter.model", model);
+            fd.setAttr("meter.serial", serial);
+        });
+
+        writer.flush();
+    }
+
+    void record(const iris::rgb &stim, const spectral_data &data, float lum) {
+        if (nwl == 0) {
+            nwl = data.data.size();
+            const size_t n = nwl;
+            const uint16_t wl_start = data.wl_start;
+            const uint16_t wl_step = data.wl_step;
+
+            writer.submit([this, n, wl_start, wl_step](h5x::File &fd) {
+                spectra = h5x::Appender(fd, "spectra", h5x::TypeId::Float, {n}, 0, this->options);
+                spectra.dataSet().setAttr("wl_start", wl_start);
+                spectra.dataSet().setAttr("wl_step", wl_step);
+            });
+        } else if (nwl != data.data.size()) {
+            throw std::runtime_error("number of wavelengths changed");
+        }
+
+        spectra_buf.insert(spectra_buf.end(), data.data.begin(), data.data.end());
+        lum_buf.push_back(lum);
+        patch_buf.push_back(stim);
+        recorded++;
+
+        if (++pending >= flush_every) {
+            flush();
+        }
+    }
+
+    // hand the pending records to the writer, without waiting for it
+    void flush() {
+        if (pending == 0) {
+            return;
+        }
+
+        batch b;
+        b.rec = this;
+        b.spectra.swap(spectra_buf);
+        b.lum.swap(lum_buf);
+        b.patches.swap(patch_buf);
+        pending = 0;
+
+        writer.submit(std::move(b));
+    }
+
+    size_t size() const {
+        return recorded;
+    }
+
+    void close() {
+        flush();
+        writer.submit([this](h5x::File &fd) {
+            spectra = h5x::Appender();
+            luminance = h5x::Appender();
+            patches = h5x::Appender();
+        });
+        writer.close();
+    }
+
+private:
+    struct batch {
+        spectra_recorder *rec;
+        std::vector<float> spectra;
+        std::vector<float> lum;
+        std::vector<iris::rgb> patches;
+
+        void operator()(h5x::File &fd) {
+            rec->spectra.append(spectra);
+            rec->luminance.append(lum);
+            rec->patches.append(patches);
+            fd.flush();
+        }
+    };
+
+    // only touched by the writer thread
+    h5x::Appender spectra;
+    h5x::Appender luminance;
+    h5x::Appender patches;
+
+    h5x::DataSetOptions options;
+    size_t flush_every;
+    size_t nwl;
+
+    // not yet handed to the writer, packed row after row
+    size_t pending;
+    size_t recorded;
+    std::vector<float> spectra_buf;
+    std::vector<float> lum_buf;
+    std::vector<iris::rgb> patch_buf;
+
+    h5x::AsyncWriter writer;
+};
+
 class robot : public looper, public gl::window {
 public:
 
-    robot(const iris::data::display &display, device::pr655 &meter, std::vector<iris::rgb> &stim, float gray_level)
-            : gl::window(display, "iris - measure"), meter(meter), stim(stim), gray_level(gray_level) {
+    robot(const iris::data::display &display, device::pr655 &meter, std::vector<iris::rgb> &stim, float gray_level,
+          spectra_recorder *recorder = nullptr)
+            : gl::window(display, "iris - measure"), meter(meter), stim(stim), gray_level(gray_level),
+              recorder(recorder) {
         make_current_context();
         setup();
     }
@@ -231,6 +366,15 @@ public:
 
         lum.push_back(br.data.Y);
         resp.push_back(data);
+
+        if (recorder) {
+            try {
+                recorder->record(stim[pos - 1], data, br.data.Y);
+            } catch (const std::exception &e) {
+                std::cerr << "[E] could not record measurement: " << e.what() << std::endl;
+            }
+        }
+
         std::cerr << " done" << std::endl;
     }
 
@@ -323,6 +467,8 @@ private:
     float gray_level;
     std::vector<spectral_data> resp;
     std::vector<float> lum;
+
+    spectra_recorder *recorder;
 };
 
 void dump_stdout(const robot &r) {
@@ -366,71 +512,6 @@ void dump_stdout(const robot &r) {
     std::cout.unsetf(std::ios_base::floatfield);
 }
 
-void save_data_h5(const std::string &path,
-                  const robot &r,
-                  const iris::data::display &display,
-                  float gray_level,
-                  device::pr655 &meter) {
-
-    const std::vector<iris::rgb> &stim = r.stimulation();
-    const std::vector<spectral_data> &resp = r.spectra();
-
-    if (resp.empty()) {
-        std::cout << "[W] No data!" << std::endl;
-        return;
-    }
-
-    size_t nwl = resp[0].data.size();
-
-    h5x::NDSize dims = {resp.size(), nwl};
-    h5x::File fd = h5x::File::open(path, "a");
-    h5x::DataSet ds;
-    if (!fd.hasData("spectra")) {
-        ds = fd.createData("spectra", h5x::TypeId::Float, dims);
-    } else {
-        ds = fd.openData("spectra");
-    }
-
-    for(size_t i = 0; i < resp.size(); i++) {
-        const std::vector<float> data = resp[i].data;
-        h5x::Selection memSel(data);
-        h5x::Selection fileSel(ds.getSpace());
-        h5x::NDSize count = {static_cast<size_t>(1), nwl};
-        h5x::NDSize offset = {i, static_cast<size_t>(0)};
-        fileSel.select(count, offset);
-        ds.write(h5x::TypeId::Float, data.data(), fileSel, memSel);
-    }
-
-    ds.setAttr("wl_start", resp[0].wl_start);
-    ds.setAttr("wl_step", resp[0].wl_step);
-
-    if (! fd.hasData("patches")) {
-        h5x::NDSize dc = {stim.size(), static_cast<size_t>(3)};
-        h5x::DataSet patches;
-        patches = fd.createData("patches", h5x::TypeId::Float, dc);
-        patches.setExtent(dc);
-        patches.write(h5x::TypeId::Float, dims, static_cast<const void *>(stim.data()));
-    }
-
-    fd.setData("luminance", r.luminance());
-    fd.setAttr("display.monitor", display.monitor_id);
-    fd.setAttr("display.link", display.link_id);
-    fd.setAttr("display.settings", display.settings_id);
-    fd.setAttr("display.gfx", display.gfx);
-    fd.setAttr("mode.height", display.mode.height);
-    fd.setAttr("mode.width", display.mode.width);
-    fd.setAttr("mode.refresh", display.mode.refresh);
-    fd.setAttr("mode.depth.r", display.mode.r);
-    fd.setAttr("mode.depth.g", display.mode.g);
-    fd.setAttr("mode.depth.b", display.mode.b);
-    fd.setAttr("gray-level", gray_level);
-    fd.setAttr("meter.model", meter.model_number());
-    fd.setAttr("meter.serial", meter.serial_number());
-
-    ds.close();
-    fd.close();
-}
-
 std::vector<iris::rgb> read_color_list(std::string path) {
     if (path == "-") {
         path = "/dev/stdin";
@@ -467,6 +548,8 @@ int main(int argc, char **argv)
     std::string mdev;
     std::string input;
     float       gray_level = 0.66f;
+    size_t      flush_every = 1;
+    std::string compression = "shuffle,deflate=4";
 
     po::options_description opts("calibration tool");
     opts.add_options()
@@ -474,6 +557,8 @@ int main(int argc, char **argv)
             ("device,d", po::value<std::string>(&device))
             ("monitor", po::value<std::string>(&mdev))
             ("gray", po::value<float>(&gray_level), "reference gray [default=0.66]")
+            ("flush-every", po::value<size_t>(&flush_every), "flush the output every n measurements [default=1]")
+            ("compression", po::value<std::string>(&compression), "HDF5 filter chain, e.g. shuffle,deflate=6,fletcher32 or none [default=shuffle,deflate=4]")
             ("input", po::value<std::string>(&input)->required());
 
     po::positional_options_description pos;
@@ -488,6 +573,14 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    h5x::DataSetOptions h5opts;
+    try {
+        h5opts = h5x::DataSetOptions::parse(compression);
+    } catch (const std::invalid_argument &e) {
+        std::cerr << "[E] " << e.what() << std::endl;
+        return 1;
+    }
+
     // ****
     std::cerr << "List of colors to measure:" << std::endl;
     std::vector<iris::rgb> colors = read_color_list(input);
@@ -549,7 +642,12 @@ int main(int argc, char **argv)
 
     // *****
 
-    robot bender(display, meter, colors, gray_level);
+    const std::string fn = "spectra-" + iris::make_timestamp() + ".h5";
+    spectra_recorder recorder(fn, flush_every, h5opts);
+    recorder.describe(display, gray_level, meter);
+    std::cerr << "[I] writing measurements to " << fn << std::endl;
+
+    robot bender(display, meter, colors, gray_level, &recorder);
 
     // **
     std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl;
@@ -577,12 +675,17 @@ int main(int argc, char **argv)
     }
 
 
+    bender.stop();
+    meter.stop();
+
     dump_stdout(bender);
-    const std::string fn = "spectra-" + iris::make_timestamp() + ".h5";
-    save_data_h5(fn, bender, display, gray_level, meter);
+    try {
+        recorder.close();
+        std::cerr << "[I] " << recorder.size() << " measurements in " << fn << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "[E] could not write " << fn << ": " << e.what() << std::endl;
+    }
 
-    meter.stop();
-    bender.stop();
     bender = nullptr;
 
     std::cerr << "Goodbay. Have a nice day!" << std::endl;
@@ -2,9 +2,12 @@
 
 #include <boost/program_options.hpp>
 #include <data.h>
+#include <check.h>
+#include <watcher.h>
 
 #include <getopt.h>
 
+#include <iomanip>
 #include <iostream>
 #include <yaml-cpp/yaml.h>
 
@@ -17,6 +20,90 @@ static int cmd_info(int argc, char **argv) {
     return 0;
 }
 
+static int cmd_clear_cache(int argc, char **argv) {
+    iris::data::store store = iris::data::store::default_store();
+
+    size_t n = store.clear_cache();
+    std::cerr << "[I] removed " << n << " cached fit results" << std::endl;
+
+    return 0;
+}
+
+static int cmd_check(int argc, char **argv) {
+    static struct option longopts[] = {
+            { "threads",    required_argument,      NULL,          'j' },
+            { "quiet",      no_argument,            NULL,          'q' },
+            { NULL,         0,                      NULL,           0 }
+    };
+
+    size_t nthreads = 0;
+    bool quiet = false;
+
+    int ch;
+    while ((ch = getopt_long(argc, argv, "j:q", longopts, NULL)) != -1) {
+        switch (ch) {
+        case 'j':
+            nthreads = std::stoul(optarg);
+            break;
+        case 'q':
+            quiet = true;
+            break;
+        default:
+            std::cerr << "usage: check [-j <threads>] [-q]" << std::endl;
+            return -1;
+        }
+    }
+
+    iris::data::store store = iris::data::store::default_store();
+    iris::data::check_report report = iris::data::check_store(store, nthreads);
+
+    for (const auto &p : report.problems) {
+        if (quiet && !p.error) {
+            continue;
+        }
+        std::cout << (p.error ? "[E] " : "[W] ") << p.file.path() << ": " << p.message << std::endl;
+    }
+
+    const double total = report.t_scan + report.t_read + report.t_xref;
+    const double mb = report.bytes / (1024.0 * 1024.0);
+
+    std::cerr << std::fixed << std::setprecision(1);
+    std::cerr << "[I] " << report.files << " files, " << mb << " MiB; ";
+    std::cerr << report.errors() << " errors, " << report.warnings() << " warnings" << std::endl;
+    std::cerr << "[I] scan " << report.t_scan << " ms, read " << report.t_read << " ms";
+    std::cerr << " (" << (report.t_read > 0 ? mb / (report.t_read / 1000.0) : 0.0) << " MiB/s, ";
+    std::cerr << (report.t_read > 0 ? report.files / (report.t_read / 1000.0) : 0.0) << " files/s), ";
+    std::cerr << "xref " << report.t_xref << " ms, total " << total << " ms" << std::endl;
+
+    return report.errors() > 0 ? 1 : 0;
+}
+
+static int cmd_watch(int argc, char **argv) {
+    iris::data::store store = iris::data::store::default_store();
+
+    if (!iris::data::store_watcher::supported()) {
+        std::cerr << "[E] watching is not supported on this platform" << std::endl;
+        return -1;
+    }
+
+    static const char *kinds[] = {
+            "links", "monitor", "settings", "rgb2lms", "subject", "isoslant", "isodata", "rescan"
+    };
+
+    iris::data::store_watcher watcher(store);
+    watcher.subscribe([](const iris::data::store_watcher::event &ev) {
+        std::cout << (ev.removed ? "- " : "+ ") << kinds[static_cast<int>(ev.kind)];
+        std::cout << " " << ev.file.path() << std::endl;
+    });
+
+    std::cerr << "[I] watching " << store.location().path() << std::endl;
+    while (true) {
+        watcher.poll(-1);
+    }
+
+    return 0;
+}
+
 static int import_rgb2lms(iris::data::store &store,
                           fs::file &fd,
                           const std::string &data) {
@@ -50,7 +137,7 @@ static int import_rgb2lms(iris::data::store &store,
         if (dest.exists()) {
             std::cerr << "[W] spectral data file already exists. skipping! " << std::endl;
         } else {
-            cac.copy(dest);
+            msd.copy(dest);
             std::cerr << "[I] spectral data imported!" << std::endl;
         }
     }
@@ -94,6 +181,10 @@ static int cmd_import(int argc, char **argv) {
         std::cerr << "[I] importing: " << entity << std::endl;
         if (entity == std::string("rgb2lms")) {
             import_rgb2lms(store, fd, data);
+        } else if (entity == std::string("subject")) {
+            iris::data::subject subject = store.yaml2subject(data);
+            store.store_subject(subject);
+            std::cerr << "[I] stored subject [" << subject.identifier() << "]" << std::endl;
         } else {
             std::cerr << "[W] cannot import this object. Skipping!" << std::endl;
         }
@@ -115,6 +206,9 @@ struct command {
 command cmds[] = {
         { "info",   "general data store information", cmd_info },
         { "import", "import data [rgb2lms, isoslant, ...] into store ", cmd_import },
+        { "clear-cache", "remove all cached fit results", cmd_clear_cache },
+        { "check",  "check the store for unreadable files and broken references", cmd_check },
+        { "watch", "print changes to the store as they happen", cmd_watch },
         { "",         "", nullptr}
 };
 
@@ -139,7 +233,7 @@ int main(int argc, char **argv)
     std::string binname = argv[0];
 
     int ch;
-    while ((ch = getopt_long(argc, argv, ":h", longopts, NULL)) != -1)
+    while ((ch = getopt_long(argc, argv, "+:h", longopts, NULL)) != -1)
         switch (ch) {
             case 'h':
                 usage(binname);
@@ -30,8 +30,7 @@ IsoslantWnd::IsoslantWnd(QWidget *parent) :
 
 void IsoslantWnd::load_isodata(const std::string &path, QCustomPlot *plot) {
     fs::file fd(path);
-    std::string raw = fd.read_all();
-    iris::data::isodata input = iris::data::store::yaml2isodata(raw);
+    iris::data::isodata input = iris::data::store::load_isodata(fd);
 
     plot_isodata(input, plot);
 }